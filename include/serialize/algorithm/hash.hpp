@@ -0,0 +1,66 @@
+/*
+  MIT License
+
+  Copyright (c) 2018 Nicolai Trandafil
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#pragma once
+
+
+// std
+#include <cstdint>
+#include <string_view>
+
+
+namespace serialize {
+
+
+/// 64 bit FNV-1a offset basis
+constexpr std::uint64_t fnv_basis = 14695981039346656037ull;
+
+
+/// 64 bit FNV-1a prime
+constexpr std::uint64_t fnv_prime = 1099511628211ull;
+
+
+/// FNV-1a hash of `str` continuing from `h`, usable at compile time
+constexpr std::uint64_t fnv1a(std::string_view str,
+                              std::uint64_t h = fnv_basis) noexcept {
+    for (auto const c: str) {
+        h ^= static_cast<unsigned char>(c);
+        h *= fnv_prime;
+    }
+    return h;
+}
+
+
+/// Feed the bytes of `x` into the FNV-1a hash `h`
+constexpr std::uint64_t hashCombine(std::uint64_t h, std::uint64_t x) noexcept {
+    for (int i = 0; i < 8; ++i) {
+        h ^= (x >> (8 * i)) & 0xff;
+        h *= fnv_prime;
+    }
+    return h;
+}
+
+
+}
@@ -0,0 +1,584 @@
+/*
+  MIT License
+
+  Copyright (c) 2018 Nicolai Trandafil
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#pragma once
+
+
+// local
+#include <serialize/algorithm/hash.hpp>
+#include <serialize/meta.hpp>
+#include <serialize/variant.hpp>
+#include <serialize/variant_conversion.hpp>
+#include <serialize/variant_traits.hpp>
+#include <serialize/when.hpp>
+
+// boost
+#include <boost/hana.hpp>
+
+// std
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+
+/// \file binary.hpp
+/// Compact positional binary format for reflected structs
+///
+/// The layout is driven by `BOOST_HANA_ADAPT_STRUCT`, field names never go on
+/// the wire. Both sides must be built from the same schema, which is checked
+/// through a 4 byte fingerprint header. The body is encoded as follows:
+///     - integers are varints, signed ones zigzag encoded;
+///     - floating point numbers are little endian IEEE 754;
+///     - strings and containers are length-prefixed;
+///     - a struct starts with a presence bitmap covering its `std::optional`
+///       members and the members having a value in `defaults()`; absent
+///       optionals and members equal to their default are skipped;
+///     - any other type goes through `Variant` as length-prefixed CBOR.
+
+
+namespace serialize {
+
+
+/// Binary decoding error
+class BinaryError : public std::runtime_error {
+public:
+    explicit BinaryError(std::string const& x)
+        : runtime_error("Binary: " + x) {}
+};
+
+
+namespace binary {
+
+
+/// Bounds checked byte source
+class Input {
+public:
+    explicit Input(std::string_view data) noexcept : data(data) {}
+
+    std::size_t left() const noexcept { return data.size() - pos; }
+
+    std::string_view bytes(std::size_t n) {
+        if (n > left()) { throw BinaryError("unexpected end of input"); }
+        auto const ret = data.substr(pos, n);
+        pos += n;
+        return ret;
+    }
+
+    std::uint64_t fixed(std::size_t n) {
+        auto const x = bytes(n);
+        std::uint64_t ret = 0;
+        for (std::size_t i = n; i-- > 0;) {
+            ret = (ret << 8) | static_cast<std::uint8_t>(x[i]);
+        }
+        return ret;
+    }
+
+    std::uint64_t varint() {
+        std::uint64_t ret = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            auto const b = static_cast<std::uint8_t>(bytes(1)[0]);
+            ret |= static_cast<std::uint64_t>(b & 0x7f) << shift;
+            if (!(b & 0x80)) { return ret; }
+        }
+        throw BinaryError("varint is too long");
+    }
+
+    /// Length prefix, bounded by the remaining input
+    std::size_t size() {
+        auto const ret = varint();
+        if (ret > left()) { throw BinaryError("length exceeds input"); }
+        return static_cast<std::size_t>(ret);
+    }
+
+private:
+    std::string_view data;
+    std::size_t pos{0};
+};
+
+
+inline void putFixed(std::string& out, std::uint64_t x, std::size_t n) {
+    for (std::size_t i = 0; i < n; ++i) {
+        out.push_back(static_cast<char>((x >> (8 * i)) & 0xff));
+    }
+}
+
+
+inline void putVarint(std::string& out, std::uint64_t x) {
+    while (x >= 0x80) {
+        out.push_back(static_cast<char>((x & 0x7f) | 0x80));
+        x >>= 7;
+    }
+    out.push_back(static_cast<char>(x));
+}
+
+
+constexpr std::uint64_t zigzag(std::int64_t x) noexcept {
+    return (static_cast<std::uint64_t>(x) << 1) ^
+           static_cast<std::uint64_t>(x >> 63);
+}
+
+
+constexpr std::int64_t unzigzag(std::uint64_t x) noexcept {
+    return static_cast<std::int64_t>(x >> 1) ^ -static_cast<std::int64_t>(x & 1);
+}
+
+
+constexpr auto const hasMappedType = boost::hana::is_valid(
+    [](auto t) -> boost::hana::type<typename decltype(t)::type::mapped_type> {});
+
+
+constexpr auto const equalityComparable = boost::hana::is_valid(
+    [](auto&& a, auto&& b) -> decltype((void) (a == b)) {});
+
+
+} // namespace binary
+
+
+/// Binary encoding of `T`
+/// Provides `write(std::string&, T)`, `read(binary::Input&)` and a
+/// compile-time `schema()` hash
+template <typename T, typename = void>
+struct BinaryImpl : BinaryImpl<T, When<true>> {};
+
+
+namespace binary {
+
+
+/// Fewest bytes encoding a `T`, one except for reflected structs
+template <typename T>
+constexpr std::size_t minSize() {
+    if constexpr (boost::hana::Struct<T>::value) {
+        return BinaryImpl<T>::minSize();
+    } else {
+        return 1;
+    }
+}
+
+
+/// Element count, bounded by the remaining input
+template <std::size_t element_size>
+std::uint64_t count(Input& in) {
+    static_assert(element_size != 0, "Elements encoded in no bytes are not supported");
+    auto const ret = in.varint();
+    if (ret > in.left() / element_size) { throw BinaryError("count exceeds input"); }
+    return ret;
+}
+
+
+} // namespace binary
+
+
+/// Fallback through `Variant` and CBOR
+template <typename T, bool condition>
+struct BinaryImpl<T, When<condition>> {
+    static void write(std::string& out, T const& x) {
+        std::string cbor;
+        if constexpr (std::is_same_v<T, Variant>) {
+            cbor = x.toCbor();
+        } else {
+            cbor = toVariant(x).toCbor();
+        }
+        binary::putVarint(out, cbor.size());
+        out += cbor;
+    }
+
+    static T read(binary::Input& in) {
+        auto var = Variant::fromCbor(in.bytes(in.size()));
+        if constexpr (std::is_same_v<T, Variant>) {
+            return var;
+        } else {
+            return fromVariant<T>(var);
+        }
+    }
+
+    static constexpr std::uint64_t schema() { return fnv1a("variant"); }
+};
+
+
+template <>
+struct BinaryImpl<bool> {
+    static void write(std::string& out, bool x) {
+        out.push_back(static_cast<char>(x));
+    }
+
+    static bool read(binary::Input& in) { return in.bytes(1)[0] != 0; }
+
+    static constexpr std::uint64_t schema() { return fnv1a("bool"); }
+};
+
+
+/// Varint, zigzag for signed types
+template <typename T>
+struct BinaryImpl<T, When<std::is_integral_v<T> && !std::is_same_v<T, bool>>> {
+    static void write(std::string& out, T x) {
+        if constexpr (std::is_signed_v<T>) {
+            binary::putVarint(out, binary::zigzag(x));
+        } else {
+            binary::putVarint(out, x);
+        }
+    }
+
+    static T read(binary::Input& in) {
+
+#if __GNUG__
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wsign-compare" // safe comparation
+
+        if constexpr (std::is_signed_v<T>) {
+            auto const x = binary::unzigzag(in.varint());
+            if (x < std::numeric_limits<T>::min() ||
+                    x > std::numeric_limits<T>::max()) {
+                throw BinaryError("integral overflow");
+            }
+            return static_cast<T>(x);
+        } else {
+            auto const x = in.varint();
+            if (x > std::numeric_limits<T>::max()) {
+                throw BinaryError("integral overflow");
+            }
+            return static_cast<T>(x);
+        }
+
+#pragma GCC diagnostic pop
+#else
+#error The compiler not supported
+#endif
+
+    }
+
+    static constexpr std::uint64_t schema() {
+        return hashCombine(fnv1a(std::is_signed_v<T> ? "int" : "uint"),
+                           sizeof(T));
+    }
+};
+
+
+template <typename T>
+struct BinaryImpl<T, When<std::is_floating_point_v<T>>> {
+    using Bits = std::conditional_t<sizeof(T) == 4, std::uint32_t, std::uint64_t>;
+    static_assert(sizeof(T) == sizeof(Bits), "Unsupported floating point type");
+
+    static void write(std::string& out, T x) {
+        Bits bits;
+        std::memcpy(&bits, &x, sizeof(x));
+        binary::putFixed(out, bits, sizeof(bits));
+    }
+
+    static T read(binary::Input& in) {
+        auto const bits = static_cast<Bits>(in.fixed(sizeof(Bits)));
+        T ret;
+        std::memcpy(&ret, &bits, sizeof(ret));
+        return ret;
+    }
+
+    static constexpr std::uint64_t schema() {
+        return hashCombine(fnv1a("float"), sizeof(T));
+    }
+};
+
+
+template <typename T>
+struct BinaryImpl<T, When<isString(type_c<T>)>> {
+    static void write(std::string& out, T const& x) {
+        binary::putVarint(out, x.size());
+        out.append(x.data(), x.size());
+    }
+
+    static T read(binary::Input& in) {
+        auto const x = in.bytes(in.size());
+        return T(x.data(), x.size());
+    }
+
+    static constexpr std::uint64_t schema() { return fnv1a("string"); }
+};
+
+
+/// Presence byte followed by the value
+template <typename T>
+struct BinaryImpl<T, When<isOptional(type_c<T>)>> {
+    using U = typename T::value_type;
+
+    static void write(std::string& out, T const& x) {
+        BinaryImpl<bool>::write(out, x.has_value());
+        if (x) { BinaryImpl<U>::write(out, *x); }
+    }
+
+    static T read(binary::Input& in) {
+        if (!BinaryImpl<bool>::read(in)) { return std::nullopt; }
+        return BinaryImpl<U>::read(in);
+    }
+
+    static constexpr std::uint64_t schema() {
+        return hashCombine(fnv1a("optional"), BinaryImpl<U>::schema());
+    }
+};
+
+
+/// Sequence containers
+template <typename T>
+struct BinaryImpl<T, When<
+        isContainer(type_c<T>) &&
+        !binary::hasMappedType(boost::hana::type_c<T>) &&
+        (hasPushBack(boost::hana::type_c<T>) ||
+         hasEmplace(boost::hana::type_c<T>))>> {
+    using U = typename T::value_type;
+
+    static void write(std::string& out, T const& x) {
+        binary::putVarint(out, std::size(x));
+        for (auto const& v: x) { BinaryImpl<U>::write(out, v); }
+    }
+
+    static T read(binary::Input& in) {
+        auto const n = binary::count<binary::minSize<U>()>(in);
+        T ret;
+        if constexpr (hasPushBack(boost::hana::type_c<T>)) {
+            if constexpr (hasReserve(boost::hana::type_c<T>)) {
+                ret.reserve(n);
+            }
+            for (std::uint64_t i = 0; i < n; ++i) {
+                ret.push_back(BinaryImpl<U>::read(in));
+            }
+        } else {
+            for (std::uint64_t i = 0; i < n; ++i) {
+                ret.emplace(BinaryImpl<U>::read(in));
+            }
+        }
+        return ret;
+    }
+
+    static constexpr std::uint64_t schema() {
+        return hashCombine(fnv1a("sequence"), BinaryImpl<U>::schema());
+    }
+};
+
+
+/// Associative containers
+template <typename T>
+struct BinaryImpl<T, When<
+        isContainer(type_c<T>) &&
+        binary::hasMappedType(boost::hana::type_c<T>)>> {
+    using K = std::decay_t<typename T::key_type>;
+    using V = typename T::mapped_type;
+
+    static void write(std::string& out, T const& x) {
+        binary::putVarint(out, std::size(x));
+        for (auto const& v: x) {
+            BinaryImpl<K>::write(out, v.first);
+            BinaryImpl<V>::write(out, v.second);
+        }
+    }
+
+    static T read(binary::Input& in) {
+        auto const n = binary::count<binary::minSize<K>() + binary::minSize<V>()>(in);
+        T ret;
+        for (std::uint64_t i = 0; i < n; ++i) {
+            auto key = BinaryImpl<K>::read(in);
+            ret.emplace(std::move(key), BinaryImpl<V>::read(in));
+        }
+        return ret;
+    }
+
+    static constexpr std::uint64_t schema() {
+        return hashCombine(hashCombine(fnv1a("map"), BinaryImpl<K>::schema()),
+                           BinaryImpl<V>::schema());
+    }
+};
+
+
+/// Reflected structs, fields are positional
+template <typename T>
+struct BinaryImpl<T, When<boost::hana::Struct<T>::value>> {
+    template <typename Get>
+    using Field = std::decay_t<decltype(std::declval<Get>()(std::declval<T&>()))>;
+
+    /// The field may be skipped as equal to its value in `T::defaults()`
+    template <typename F, typename Name>
+    static constexpr bool defaulted(Name name) {
+        if constexpr (isOptional(type_c<F>)) {
+            (void) name;
+            return false;
+        } else if constexpr (trait::detail::hasDefaultValue<T>(name)) {
+            return decltype(binary::equalityComparable(
+                std::declval<F const&>(), std::declval<F const&>()))::value;
+        } else {
+            return false;
+        }
+    }
+
+    template <typename F, typename Name>
+    static constexpr bool elidable(Name name) {
+        return isOptional(type_c<F>) || defaulted<F>(name);
+    }
+
+    static constexpr std::size_t countElidable() {
+        std::size_t ret = 0;
+        boost::hana::for_each(boost::hana::accessors<T>(),
+                              boost::hana::fuse([&](auto name, auto get) {
+            if constexpr (elidable<Field<decltype(get)>>(name)) { ++ret; }
+        }));
+        return ret;
+    }
+
+    static constexpr std::size_t bitmap_size = (countElidable() + 7) / 8;
+
+    /// The bitmap and the fields that cannot be elided
+    static constexpr std::size_t minSize() {
+        auto ret = bitmap_size;
+        boost::hana::for_each(boost::hana::accessors<T>(),
+                              boost::hana::fuse([&](auto name, auto get) {
+            using F = Field<decltype(get)>;
+            if constexpr (!elidable<F>(name)) { ret += binary::minSize<F>(); }
+        }));
+        return ret;
+    }
+
+    static void write(std::string& out, T const& x) {
+        auto const bitmap = out.size();
+        out.append(bitmap_size, '\0');
+        std::size_t bit = 0;
+
+        auto const present = [&] {
+            out[bitmap + bit / 8] |= static_cast<char>(1 << (bit % 8));
+        };
+
+        boost::hana::for_each(boost::hana::accessors<T>(),
+                              boost::hana::fuse([&](auto name, auto get) {
+            using F = Field<decltype(get)>;
+            auto const& value = get(x);
+            if constexpr (isOptional(type_c<F>)) {
+                if (value.has_value()) {
+                    present();
+                    BinaryImpl<typename F::value_type>::write(out, *value);
+                }
+                ++bit;
+            } else if constexpr (defaulted<F>(name)) {
+                if (!(value == get(trait::detail::prototype<T>()))) {
+                    present();
+                    BinaryImpl<F>::write(out, value);
+                }
+                ++bit;
+            } else {
+                BinaryImpl<F>::write(out, value);
+            }
+        }));
+    }
+
+    static T read(binary::Input& in) {
+        auto const bitmap = in.bytes(bitmap_size);
+        std::size_t bit = 0;
+
+        auto const present = [&] {
+            auto const ret = (bitmap[bit / 8] >> (bit % 8)) & 1;
+            ++bit;
+            return ret != 0;
+        };
+
+        T ret;
+        boost::hana::for_each(boost::hana::accessors<T>(),
+                              boost::hana::fuse([&](auto name, auto get) {
+            using F = Field<decltype(get)>;
+            auto& value = get(ret);
+            if constexpr (isOptional(type_c<F>)) {
+                if (present()) {
+                    value = BinaryImpl<typename F::value_type>::read(in);
+                } else {
+                    value.reset();
+                }
+            } else if constexpr (defaulted<F>(name)) {
+                if (present()) {
+                    value = BinaryImpl<F>::read(in);
+                } else {
+                    value = get(trait::detail::prototype<T>());
+                }
+            } else {
+                value = BinaryImpl<F>::read(in);
+            }
+        }));
+        return ret;
+    }
+
+    static constexpr std::uint64_t schema() {
+        std::uint64_t ret = fnv1a("struct");
+        boost::hana::for_each(boost::hana::accessors<T>(),
+                              boost::hana::fuse([&](auto name, auto get) {
+            using F = Field<decltype(get)>;
+            ret = fnv1a(boost::hana::to<char const*>(name), ret);
+            ret = hashCombine(ret, BinaryImpl<F>::schema());
+            ret = hashCombine(ret, defaulted<F>(name));
+        }));
+        return ret;
+    }
+};
+
+
+/// Schema fingerprint put in front of the encoded `T`
+template <typename T>
+constexpr std::uint32_t binarySchemaFingerprint() {
+    constexpr auto h = BinaryImpl<std::decay_t<T>>::schema();
+    return static_cast<std::uint32_t>(h ^ (h >> 32));
+}
+
+
+struct ToBinaryT {
+    template <typename T>
+    std::string operator()(T const& x) const {
+        std::string ret;
+        binary::putFixed(ret, binarySchemaFingerprint<T>(), 4);
+        BinaryImpl<T>::write(ret, x);
+        return ret;
+    }
+};
+
+
+/// Encode `x` with the schema fingerprint header
+constexpr ToBinaryT toBinary;
+
+
+template <typename T>
+struct FromBinaryT {
+    /// \throw `BinaryError` on fingerprint mismatch or malformed input
+    T operator()(std::string_view data) const {
+        binary::Input in(data);
+        if (in.fixed(4) != binarySchemaFingerprint<T>()) {
+            throw BinaryError("schema fingerprint mismatch");
+        }
+        auto ret = BinaryImpl<T>::read(in);
+        if (in.left() != 0) { throw BinaryError("trailing bytes"); }
+        return ret;
+    }
+};
+
+
+/// Decode a `T` encoded with `toBinary`
+template <typename T>
+constexpr FromBinaryT<T> fromBinary;
+
+
+}
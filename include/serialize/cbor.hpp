@@ -0,0 +1,447 @@
+/*
+  MIT License
+
+  Copyright (c) 2018 Nicolai Trandafil
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#pragma once
+
+
+// std
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+/// \file cbor.hpp
+/// CBOR (RFC 8949) SAX-style reader and writer
+///
+/// Both sides speak the same handler protocol:
+///     `bool Null()`
+///     `bool Bool(bool)`
+///     `bool Int64(std::int64_t)`
+///     `bool Uint64(std::uint64_t)`
+///     `bool Double(double)`
+///     `bool String(std::string_view)`
+///     `bool Bytes(std::string_view)`
+///     `bool StartArray(std::size_t)`, `bool EndArray()`
+///     `bool StartObject(std::size_t)`, `bool Key(std::string_view)`,
+///     `bool EndObject()`
+///
+/// where the size passed to `Start*` is `cbor::indefinite` for
+/// indefinite-length items. A `Reader` can thus be plugged directly into a
+/// `Writer` for transcoding.
+
+
+namespace serialize::cbor {
+
+
+/// CBOR decoding error
+class CborError : public std::runtime_error {
+public:
+    explicit CborError(std::string const& x) : runtime_error("CBOR: " + x) {}
+};
+
+
+/// Length of the indefinite-length items
+constexpr std::size_t indefinite = std::numeric_limits<std::size_t>::max();
+
+
+/// Major types
+enum class Major : std::uint8_t {
+    unsigned_int = 0,
+    negative_int = 1,
+    bytes = 2,
+    text = 3,
+    array = 4,
+    map = 5,
+    tag = 6,
+    simple = 7
+};
+
+
+namespace detail {
+
+
+constexpr std::uint8_t break_byte = 0xff;
+constexpr std::uint8_t info_indefinite = 31;
+
+
+inline double halfToDouble(std::uint16_t half) {
+    int const exp = (half >> 10) & 0x1f;
+    int const mant = half & 0x3ff;
+    double val;
+    if (exp == 0) {
+        val = std::ldexp(mant, -24);
+    } else if (exp != 31) {
+        val = std::ldexp(mant + 1024, exp - 25);
+    } else {
+        val = mant == 0 ? std::numeric_limits<double>::infinity()
+                        : std::numeric_limits<double>::quiet_NaN();
+    }
+    return (half & 0x8000) ? -val : val;
+}
+
+
+} // namespace detail
+
+
+///
+/// Pull-free, non-recursive CBOR decoder
+///
+/// Definite-length byte and text strings are delivered as views into the
+/// input buffer; chunked (indefinite-length) strings are concatenated into an
+/// internal buffer whose view is valid only during the callback.
+///
+/// Map keys must be text or byte strings. Tags are skipped, `undefined` is
+/// reported as `Null()`.
+///
+class Reader {
+public:
+    explicit Reader(std::string_view data) noexcept : data(data) {}
+
+    /// Decode one data item
+    /// \return number of consumed bytes
+    /// \throw `CborError` on malformed input or if the handler returns false
+    template <typename Handler>
+    std::size_t parse(Handler& h);
+
+private:
+    struct Frame {
+        std::size_t left;
+        bool indefinite;
+        bool map;
+        bool key;
+    };
+
+    std::uint8_t byte() {
+        if (pos == data.size()) { throw CborError("unexpected end of input"); }
+        return static_cast<std::uint8_t>(data[pos++]);
+    }
+
+    std::uint64_t bigEndian(std::size_t n) {
+        if (data.size() - pos < n) {
+            throw CborError("unexpected end of input");
+        }
+        std::uint64_t ret = 0;
+        for (std::size_t i = 0; i < n; ++i) {
+            ret = (ret << 8) | static_cast<std::uint8_t>(data[pos++]);
+        }
+        return ret;
+    }
+
+    std::uint64_t argument(std::uint8_t info) {
+        if (info < 24) { return info; }
+        switch (info) {
+        case 24: return bigEndian(1);
+        case 25: return bigEndian(2);
+        case 26: return bigEndian(4);
+        case 27: return bigEndian(8);
+        default: throw CborError("reserved additional information");
+        }
+    }
+
+    /// Number of items (or pairs) which may follow, bounded by the input size
+    std::size_t count(std::uint64_t n, bool map) const {
+        auto const left = data.size() - pos;
+        if (n > left || (map && n > left / 2)) {
+            throw CborError("length exceeds input");
+        }
+        return static_cast<std::size_t>(n);
+    }
+
+    std::string_view chunk(std::uint8_t info) {
+        auto const n = argument(info);
+        if (n > data.size() - pos) { throw CborError("length exceeds input"); }
+        auto const ret = data.substr(pos, static_cast<std::size_t>(n));
+        pos += static_cast<std::size_t>(n);
+        return ret;
+    }
+
+    std::string_view string(Major major, std::uint8_t info) {
+        if (info != detail::info_indefinite) { return chunk(info); }
+        buffer.clear();
+        for (;;) {
+            auto const ib = byte();
+            if (ib == detail::break_byte) { return buffer; }
+            if (Major(ib >> 5) != major || (ib & 0x1f) == detail::info_indefinite) {
+                throw CborError("invalid chunk in indefinite-length string");
+            }
+            buffer += chunk(ib & 0x1f);
+        }
+    }
+
+    static void check(bool x) {
+        if (!x) { throw CborError("parse aborted by handler"); }
+    }
+
+    std::string_view data;
+    std::size_t pos{0};
+    std::string buffer;
+    std::vector<Frame> stack;
+};
+
+
+///
+/// CBOR encoder appending to a byte buffer
+///
+/// Containers started with `cbor::indefinite` are closed with a break byte, so
+/// the producer can stream items without knowing their count upfront.
+///
+class Writer {
+public:
+    explicit Writer(std::string& out) noexcept : out(out) {}
+
+    bool Null() { out.push_back(char(0xf6)); return true; }
+    bool Bool(bool x) { out.push_back(char(x ? 0xf5 : 0xf4)); return true; }
+
+    bool Int64(std::int64_t x) {
+        if (x < 0) {
+            head(Major::negative_int, static_cast<std::uint64_t>(-(x + 1)));
+        } else {
+            head(Major::unsigned_int, static_cast<std::uint64_t>(x));
+        }
+        return true;
+    }
+
+    bool Uint64(std::uint64_t x) { head(Major::unsigned_int, x); return true; }
+
+    /// Encoded as single precision when it is lossless
+    bool Double(double x) {
+        // converting a finite value beyond the range of `float` is undefined
+        if (!std::isfinite(x) || std::fabs(x) <= std::numeric_limits<float>::max()) {
+            auto const f = static_cast<float>(x);
+            if (static_cast<double>(f) == x || std::isnan(x)) {
+                std::uint32_t bits;
+                std::memcpy(&bits, &f, sizeof(bits));
+                out.push_back(char(0xfa));
+                bigEndian(bits, 4);
+                return true;
+            }
+        }
+
+        std::uint64_t bits;
+        std::memcpy(&bits, &x, sizeof(bits));
+        out.push_back(char(0xfb));
+        bigEndian(bits, 8);
+        return true;
+    }
+
+    bool String(std::string_view x) { return str(Major::text, x); }
+    bool Bytes(std::string_view x) { return str(Major::bytes, x); }
+    bool Key(std::string_view x) { return str(Major::text, x); }
+
+    bool StartArray(std::size_t size = indefinite) {
+        return start(Major::array, size);
+    }
+
+    bool EndArray() { return end(); }
+
+    bool StartObject(std::size_t size = indefinite) {
+        return start(Major::map, size);
+    }
+
+    bool EndObject() { return end(); }
+
+private:
+    void bigEndian(std::uint64_t x, std::size_t n) {
+        for (std::size_t i = n; i-- > 0;) {
+            out.push_back(static_cast<char>((x >> (8 * i)) & 0xff));
+        }
+    }
+
+    void head(Major major, std::uint64_t x) {
+        auto const m = static_cast<std::uint8_t>(major) << 5;
+        if (x < 24) {
+            out.push_back(static_cast<char>(m | x));
+        } else if (x <= 0xff) {
+            out.push_back(static_cast<char>(m | 24));
+            bigEndian(x, 1);
+        } else if (x <= 0xffff) {
+            out.push_back(static_cast<char>(m | 25));
+            bigEndian(x, 2);
+        } else if (x <= 0xffffffff) {
+            out.push_back(static_cast<char>(m | 26));
+            bigEndian(x, 4);
+        } else {
+            out.push_back(static_cast<char>(m | 27));
+            bigEndian(x, 8);
+        }
+    }
+
+    bool str(Major major, std::string_view x) {
+        head(major, x.size());
+        out.append(x.data(), x.size());
+        return true;
+    }
+
+    bool start(Major major, std::size_t size) {
+        auto const indef = size == indefinite;
+        if (indef) {
+            out.push_back(static_cast<char>(
+                (static_cast<std::uint8_t>(major) << 5) |
+                detail::info_indefinite));
+        } else {
+            head(major, size);
+        }
+        open.push_back(indef);
+        return true;
+    }
+
+    bool end() {
+        if (open.back()) { out.push_back(char(detail::break_byte)); }
+        open.pop_back();
+        return true;
+    }
+
+    std::string& out;
+    std::vector<bool> open;
+};
+
+
+template <typename Handler>
+std::size_t Reader::parse(Handler& h) {
+    stack.clear();
+
+    // Called after an item has been fully read, closes finished containers
+    auto const done = [&] {
+        while (!stack.empty()) {
+            auto& top = stack.back();
+            if (top.map) {
+                top.key = !top.key;
+                if (!top.key) { return; }
+            }
+            if (top.indefinite || --top.left != 0) { return; }
+            check(top.map ? h.EndObject() : h.EndArray());
+            stack.pop_back();
+        }
+    };
+
+    for (;;) {
+        auto const ib = byte();
+        auto const major = Major(ib >> 5);
+        std::uint8_t const info = ib & 0x1f;
+
+        if (ib == detail::break_byte) {
+            if (stack.empty() || !stack.back().indefinite ||
+                    (stack.back().map && !stack.back().key)) {
+                throw CborError("unexpected break");
+            }
+            check(stack.back().map ? h.EndObject() : h.EndArray());
+            stack.pop_back();
+            done();
+            if (stack.empty()) { return pos; }
+            continue;
+        }
+
+        if (!stack.empty() && stack.back().map && stack.back().key) {
+            if (major != Major::text && major != Major::bytes) {
+                throw CborError("map keys must be strings");
+            }
+            check(h.Key(string(major, info)));
+            done();
+            continue;
+        }
+
+        switch (major) {
+        case Major::unsigned_int:
+            check(h.Uint64(argument(info)));
+            break;
+
+        case Major::negative_int: {
+            auto const x = argument(info);
+            if (x > static_cast<std::uint64_t>(
+                        std::numeric_limits<std::int64_t>::max())) {
+                throw CborError("negative integer out of range");
+            }
+            check(h.Int64(-1 - static_cast<std::int64_t>(x)));
+            break;
+        }
+
+        case Major::bytes:
+            check(h.Bytes(string(major, info)));
+            break;
+
+        case Major::text:
+            check(h.String(string(major, info)));
+            break;
+
+        case Major::array:
+        case Major::map: {
+            auto const map = major == Major::map;
+            auto const indef = info == detail::info_indefinite;
+            auto const n = indef ? indefinite : count(argument(info), map);
+            check(map ? h.StartObject(n) : h.StartArray(n));
+            if (n == 0) {
+                check(map ? h.EndObject() : h.EndArray());
+                break;
+            }
+            stack.push_back(Frame{n, indef, map, map});
+            continue;
+        }
+
+        case Major::tag:
+            argument(info);
+            continue;
+
+        case Major::simple:
+            switch (info) {
+            case 20: check(h.Bool(false)); break;
+            case 21: check(h.Bool(true)); break;
+            case 22:
+            case 23: check(h.Null()); break;
+            case 25:
+                check(h.Double(detail::halfToDouble(
+                    static_cast<std::uint16_t>(bigEndian(2)))));
+                break;
+            case 26: {
+                auto const bits = static_cast<std::uint32_t>(bigEndian(4));
+                float x;
+                std::memcpy(&x, &bits, sizeof(x));
+                check(h.Double(x));
+                break;
+            }
+            case 27: {
+                auto const bits = bigEndian(8);
+                double x;
+                std::memcpy(&x, &bits, sizeof(x));
+                check(h.Double(x));
+                break;
+            }
+            default:
+                throw CborError("unsupported simple value");
+            }
+            break;
+        }
+
+        done();
+        if (stack.empty()) { return pos; }
+    }
+}
+
+
+}
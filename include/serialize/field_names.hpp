@@ -0,0 +1,259 @@
+/*
+  MIT License
+
+  Copyright (c) 2018 Nicolai Trandafil
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#pragma once
+
+
+// local
+#include <serialize/algorithm/hash.hpp>
+#include <serialize/string_map.hpp>
+
+// boost
+#include <boost/hana.hpp>
+
+// std
+#include <array>
+#include <cstdint>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+
+/// \file field_names.hpp
+/// Compile-time tables of the member names of reflected structs
+
+
+namespace serialize {
+
+
+namespace detail {
+
+
+template <typename T>
+constexpr std::size_t fieldCount() {
+    return decltype(boost::hana::length(boost::hana::accessors<T>()))::value;
+}
+
+
+template <typename T>
+constexpr auto fieldNames() {
+    std::array<std::string_view, fieldCount<T>()> ret{};
+    std::size_t i = 0;
+    boost::hana::for_each(boost::hana::accessors<T>(),
+                          boost::hana::fuse([&](auto name, auto) {
+        ret[i++] = std::string_view(
+            boost::hana::to<char const*>(name),
+            decltype(boost::hana::length(name))::value);
+    }));
+    return ret;
+}
+
+
+template <std::size_t N>
+constexpr auto fieldHashes(std::array<std::string_view, N> const& names) {
+    std::array<std::uint64_t, N> ret{};
+    for (std::size_t i = 0; i < N; ++i) { ret[i] = fnv1a(names[i]); }
+    return ret;
+}
+
+
+constexpr std::size_t ceilPow2(std::size_t n) noexcept {
+    std::size_t ret = 1;
+    while (ret < n) { ret *= 2; }
+    return ret;
+}
+
+
+constexpr std::uint64_t mixHash(std::uint64_t h, std::uint32_t seed) noexcept {
+    h ^= (seed + 1) * 0x9e3779b97f4a7c15ull;
+    h ^= h >> 31;
+    h *= 0xbf58476d1ce4e5b9ull;
+    h ^= h >> 29;
+    return h;
+}
+
+
+///
+/// Minimal perfect hash of `N` distinct hashes, by hash and displace
+///
+/// Keys are spread over buckets, each bucket holds the seed mapping all of
+/// its keys to free slots of the table.
+///
+template <std::size_t N>
+struct PerfectHash {
+    static_assert(N < 0xffff, "Too many keys");
+
+    static constexpr std::size_t buckets = ceilPow2(N);
+    static constexpr std::size_t slots = ceilPow2(2 * N);
+    static constexpr std::uint32_t max_seed = 1 << 16;
+
+    std::array<std::uint32_t, buckets> seeds{};
+
+    /// Key index plus one, 0 when free
+    std::array<std::uint16_t, slots> table{};
+
+    bool ok{false};
+
+    static constexpr std::size_t bucket(std::uint64_t h) noexcept {
+        return static_cast<std::size_t>(h ^ (h >> 32)) & (buckets - 1);
+    }
+
+    static constexpr std::size_t slot(std::uint64_t h, std::uint32_t seed) noexcept {
+        return static_cast<std::size_t>(mixHash(h, seed)) & (slots - 1);
+    }
+
+    /// Index of the key hashed `h` if any, `N` or a wrong index otherwise
+    constexpr std::size_t find(std::uint64_t h) const noexcept {
+        std::size_t const x = table[slot(h, seeds[bucket(h)])];
+        return x == 0 ? N : x - 1;
+    }
+};
+
+
+template <std::size_t N>
+constexpr PerfectHash<N> perfectHash(std::array<std::uint64_t, N> const& hashes) {
+    using P = PerfectHash<N>;
+    P ret;
+
+    std::array<std::size_t, P::buckets> sizes{};
+    std::size_t largest = 0;
+    for (std::size_t i = 0; i < N; ++i) {
+        auto& n = sizes[P::bucket(hashes[i])];
+        if (++n > largest) { largest = n; }
+    }
+
+    // the fullest buckets first, while the table is empty
+    for (auto size = largest; size > 0; --size) {
+        for (std::size_t b = 0; b < P::buckets; ++b) {
+            if (sizes[b] != size) { continue; }
+
+            bool placed = false;
+            for (std::uint32_t seed = 0; !placed && seed < P::max_seed; ++seed) {
+                std::array<std::size_t, N> taken{};
+                std::size_t n = 0;
+                bool fits = true;
+                for (std::size_t i = 0; fits && i < N; ++i) {
+                    if (P::bucket(hashes[i]) != b) { continue; }
+                    auto const s = P::slot(hashes[i], seed);
+                    fits = ret.table[s] == 0;
+                    for (std::size_t j = 0; fits && j < n; ++j) {
+                        fits = taken[j] != s;
+                    }
+                    taken[n++] = s;
+                }
+
+                if (fits) {
+                    ret.seeds[b] = seed;
+                    for (std::size_t i = 0; i < N; ++i) {
+                        if (P::bucket(hashes[i]) == b) {
+                            ret.table[P::slot(hashes[i], seed)] =
+                                    static_cast<std::uint16_t>(i + 1);
+                        }
+                    }
+                    placed = true;
+                }
+            }
+
+            if (!placed) { return ret; }
+        }
+    }
+
+    ret.ok = true;
+    return ret;
+}
+
+
+} // namespace detail
+
+
+///
+/// Names of the members of `T` in declaration order, with their lengths and
+/// hashes computed at compile time
+///
+template <typename T>
+struct FieldNames {
+    static constexpr std::size_t size = detail::fieldCount<T>();
+
+    static constexpr std::array<std::string_view, size> names =
+            detail::fieldNames<T>();
+
+    static constexpr std::array<std::uint64_t, size> hashes =
+            detail::fieldHashes(names);
+
+    static constexpr detail::PerfectHash<size> perfect =
+            detail::perfectHash(hashes);
+
+    static_assert(perfect.ok, "No perfect hash found for the member names");
+
+    /// Lookup key of the member `i`
+    static constexpr PrehashedKey key(std::size_t i) noexcept {
+        return {names[i], hashes[i]};
+    }
+
+    /// Index of the member named `key`, `size` if there is none
+    /// One table probe and one string comparison
+    static constexpr std::size_t find(PrehashedKey key) noexcept {
+        auto const i = perfect.find(key.hash);
+        return i < size && names[i] == key.name ? i : size;
+    }
+};
+
+
+/// Member `I` of the reflected struct `x`
+template <std::size_t I, typename T>
+constexpr decltype(auto) member(T&& x) {
+    auto const get = boost::hana::second(
+        boost::hana::at_c<I>(boost::hana::accessors<std::decay_t<T>>()));
+    return get(std::forward<T>(x));
+}
+
+
+namespace detail {
+
+
+template <typename F, std::size_t ...I>
+void visitField(std::size_t i, F& f, std::index_sequence<I...>) {
+    using Fn = void (*)(F&);
+    static constexpr Fn table[] = {
+        [](F& g) { g(boost::hana::size_c<I>); }...
+    };
+    table[i](f);
+}
+
+
+} // namespace detail
+
+
+/// Call `f(boost::hana::size_c<i>)` for a run time member index `i` of `T`
+/// through a jump table
+template <typename T, typename F>
+void visitField(std::size_t i, F&& f) {
+    if constexpr (FieldNames<T>::size != 0) {
+        detail::visitField(i, f, std::make_index_sequence<FieldNames<T>::size>());
+    }
+}
+
+
+}
@@ -0,0 +1,550 @@
+/*
+  MIT License
+
+  Copyright (c) 2018 Nicolai Trandafil
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#pragma once
+
+
+// local
+#include <serialize/algorithm/hash.hpp>
+#include <serialize/binary.hpp>
+#include <serialize/meta.hpp>
+#include <serialize/when.hpp>
+
+// boost
+#include <boost/hana.hpp>
+
+// std
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+
+/// \file flat.hpp
+/// Zero-copy readable layout for reflected structs
+///
+/// `flat::build` lays a value out so that it can be read in place, e.g. from
+/// a memory mapped file, through `flat::View<T>` without any parsing or
+/// allocation:
+///     - a struct is a table of fixed-size slots in declaration order, nested
+///       structs are inlined;
+///     - scalars are stored in their slot in host (little endian) order;
+///     - strings and containers store an (offset, size) pair of 32 bit
+///       integers pointing to their payload;
+///     - container elements are laid out like slots with a fixed stride,
+///       map entries are sorted by key for a binary search lookup;
+///     - `std::optional` is a presence byte followed by the value slot.
+///
+/// The buffer starts with a schema fingerprint and is otherwise trusted, i.e.
+/// offsets are not verified on access.
+
+
+#if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error Only little endian hosts are supported
+#endif
+
+
+namespace serialize::flat {
+
+
+/// Flat buffer error
+class FlatError : public std::runtime_error {
+public:
+    explicit FlatError(std::string const& x) : runtime_error("Flat: " + x) {}
+};
+
+
+/// Size of the buffer header
+constexpr std::size_t header_size = 8;
+
+
+/// Buffer being built
+class Builder {
+public:
+    /// Append `n` zeroed bytes
+    /// \return offset of the appended bytes
+    std::size_t allocate(std::size_t n) {
+        auto const ret = buf.size();
+        if (ret + n > std::numeric_limits<std::uint32_t>::max()) {
+            throw FlatError("buffer exceeds 4GiB");
+        }
+        buf.append(n, '\0');
+        return ret;
+    }
+
+    template <typename T>
+    void put(std::size_t at, T x) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        std::memcpy(buf.data() + at, &x, sizeof(x));
+    }
+
+    void put(std::size_t at, std::uint32_t offset, std::uint32_t size) {
+        put(at, offset);
+        put(at + 4, size);
+    }
+
+    std::string buf;
+};
+
+
+template <typename T>
+T load(char const* base, std::size_t at) noexcept {
+    T ret;
+    std::memcpy(&ret, base + at, sizeof(ret));
+    return ret;
+}
+
+
+/// Flat layout of `T`
+/// Provides the slot `size`, `write(Builder&, std::size_t slot, T)`,
+/// `view(char const* base, std::size_t slot)` and
+/// `load(char const* base, std::size_t slot)`
+template <typename T, typename = void>
+struct FlatImpl : FlatImpl<T, When<true>> {};
+
+
+/// Fallback
+template <typename T, bool condition>
+struct FlatImpl<T, When<condition>> {
+    static_assert(DependentFalse<T>::value, "No flat layout is provided");
+};
+
+
+/// Arithmetic types, stored inline
+template <typename T>
+struct FlatImpl<T, When<std::is_arithmetic_v<T>>> {
+    static constexpr std::size_t size = sizeof(T);
+
+    static void write(Builder& b, std::size_t slot, T x) { b.put(slot, x); }
+
+    static T view(char const* base, std::size_t slot) noexcept {
+        return flat::load<T>(base, slot);
+    }
+
+    static T load(char const* base, std::size_t slot) noexcept {
+        return view(base, slot);
+    }
+};
+
+
+template <typename T>
+struct FlatImpl<T, When<isString(type_c<T>)>> {
+    static constexpr std::size_t size = 8;
+
+    static void write(Builder& b, std::size_t slot, T const& x) {
+        auto const at = b.allocate(x.size());
+        std::memcpy(b.buf.data() + at, x.data(), x.size());
+        b.put(slot, static_cast<std::uint32_t>(at),
+              static_cast<std::uint32_t>(x.size()));
+    }
+
+    static std::string_view view(char const* base, std::size_t slot) noexcept {
+        return std::string_view(
+            base + flat::load<std::uint32_t>(base, slot),
+            flat::load<std::uint32_t>(base, slot + 4));
+    }
+
+    static T load(char const* base, std::size_t slot) {
+        auto const x = view(base, slot);
+        return T(x.data(), x.size());
+    }
+};
+
+
+template <typename T>
+struct FlatImpl<T, When<isOptional(type_c<T>)>> {
+    using U = typename T::value_type;
+
+    static constexpr std::size_t size = 1 + FlatImpl<U>::size;
+
+    static void write(Builder& b, std::size_t slot, T const& x) {
+        b.put(slot, static_cast<bool>(x));
+        if (x) { FlatImpl<U>::write(b, slot + 1, *x); }
+    }
+
+    static auto view(char const* base, std::size_t slot)
+            -> std::optional<decltype(FlatImpl<U>::view(base, slot))> {
+        if (!flat::load<bool>(base, slot)) { return std::nullopt; }
+        return FlatImpl<U>::view(base, slot + 1);
+    }
+
+    static T load(char const* base, std::size_t slot) {
+        if (!flat::load<bool>(base, slot)) { return std::nullopt; }
+        return FlatImpl<U>::load(base, slot + 1);
+    }
+};
+
+
+/// Random access range over elements laid out with a fixed stride
+template <typename T>
+class Vector {
+public:
+    using value_type = decltype(FlatImpl<T>::view(nullptr, 0));
+
+    class const_iterator {
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = typename Vector::value_type;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = value_type;
+
+        const_iterator(char const* base, std::size_t at) noexcept
+            : base(base), at(at) {}
+
+        value_type operator*() const { return FlatImpl<T>::view(base, at); }
+
+        const_iterator& operator++() noexcept {
+            at += FlatImpl<T>::size;
+            return *this;
+        }
+
+        bool operator==(const_iterator const& rhs) const noexcept {
+            return at == rhs.at;
+        }
+
+        bool operator!=(const_iterator const& rhs) const noexcept {
+            return at != rhs.at;
+        }
+
+    private:
+        char const* base;
+        std::size_t at;
+    };
+
+    Vector(char const* base, std::size_t at, std::size_t count) noexcept
+        : base(base), at(at), count(count) {}
+
+    std::size_t size() const noexcept { return count; }
+    bool empty() const noexcept { return count == 0; }
+
+    value_type operator[](std::size_t i) const {
+        return FlatImpl<T>::view(base, at + i * FlatImpl<T>::size);
+    }
+
+    const_iterator begin() const noexcept { return {base, at}; }
+
+    const_iterator end() const noexcept {
+        return {base, at + count * FlatImpl<T>::size};
+    }
+
+private:
+    char const* base;
+    std::size_t at;
+    std::size_t count;
+};
+
+
+/// Sorted key-value range with a binary search lookup
+template <typename K, typename V>
+class Map {
+public:
+    using key_type = decltype(FlatImpl<K>::view(nullptr, 0));
+    using mapped_type = decltype(FlatImpl<V>::view(nullptr, 0));
+    static constexpr std::size_t stride = FlatImpl<K>::size + FlatImpl<V>::size;
+
+    Map(char const* base, std::size_t at, std::size_t count) noexcept
+        : base(base), at(at), count(count) {}
+
+    std::size_t size() const noexcept { return count; }
+    bool empty() const noexcept { return count == 0; }
+
+    key_type key(std::size_t i) const {
+        return FlatImpl<K>::view(base, at + i * stride);
+    }
+
+    mapped_type value(std::size_t i) const {
+        return FlatImpl<V>::view(base, at + i * stride + FlatImpl<K>::size);
+    }
+
+    std::optional<mapped_type> find(key_type const& x) const {
+        std::size_t lo = 0;
+        std::size_t hi = count;
+        while (lo < hi) {
+            auto const mid = lo + (hi - lo) / 2;
+            auto const k = key(mid);
+            if (k < x) {
+                lo = mid + 1;
+            } else if (x < k) {
+                hi = mid;
+            } else {
+                return value(mid);
+            }
+        }
+        return std::nullopt;
+    }
+
+private:
+    char const* base;
+    std::size_t at;
+    std::size_t count;
+};
+
+
+/// Sequence containers
+template <typename T>
+struct FlatImpl<T, When<
+        isContainer(type_c<T>) &&
+        !binary::hasMappedType(boost::hana::type_c<T>) &&
+        (hasPushBack(boost::hana::type_c<T>) ||
+         hasEmplace(boost::hana::type_c<T>))>> {
+    using U = typename T::value_type;
+
+    static constexpr std::size_t size = 8;
+
+    static void write(Builder& b, std::size_t slot, T const& x) {
+        auto const n = std::size(x);
+        auto at = b.allocate(n * FlatImpl<U>::size);
+        b.put(slot, static_cast<std::uint32_t>(at),
+              static_cast<std::uint32_t>(n));
+        for (auto const& v: x) {
+            FlatImpl<U>::write(b, at, v);
+            at += FlatImpl<U>::size;
+        }
+    }
+
+    static Vector<U> view(char const* base, std::size_t slot) noexcept {
+        return Vector<U>(base,
+                         flat::load<std::uint32_t>(base, slot),
+                         flat::load<std::uint32_t>(base, slot + 4));
+    }
+
+    static T load(char const* base, std::size_t slot) {
+        auto at = flat::load<std::uint32_t>(base, slot);
+        auto const n = flat::load<std::uint32_t>(base, slot + 4);
+        T ret;
+        if constexpr (hasReserve(boost::hana::type_c<T>)) { ret.reserve(n); }
+        for (std::uint32_t i = 0; i < n; ++i, at += FlatImpl<U>::size) {
+            if constexpr (hasPushBack(boost::hana::type_c<T>)) {
+                ret.push_back(FlatImpl<U>::load(base, at));
+            } else {
+                ret.emplace(FlatImpl<U>::load(base, at));
+            }
+        }
+        return ret;
+    }
+};
+
+
+/// Associative containers, entries are sorted by key
+template <typename T>
+struct FlatImpl<T, When<
+        isContainer(type_c<T>) &&
+        binary::hasMappedType(boost::hana::type_c<T>)>> {
+    using K = std::decay_t<typename T::key_type>;
+    using V = typename T::mapped_type;
+    using Entries = Map<K, V>;
+
+    static constexpr std::size_t size = 8;
+
+    static void write(Builder& b, std::size_t slot, T const& x) {
+        std::vector<typename T::value_type const*> entries;
+        entries.reserve(std::size(x));
+        for (auto const& v: x) { entries.push_back(&v); }
+        std::sort(entries.begin(), entries.end(), [](auto a, auto b) {
+            return a->first < b->first;
+        });
+
+        auto at = b.allocate(entries.size() * Entries::stride);
+        b.put(slot, static_cast<std::uint32_t>(at),
+              static_cast<std::uint32_t>(entries.size()));
+        for (auto const v: entries) {
+            FlatImpl<K>::write(b, at, v->first);
+            FlatImpl<V>::write(b, at + FlatImpl<K>::size, v->second);
+            at += Entries::stride;
+        }
+    }
+
+    static Entries view(char const* base, std::size_t slot) noexcept {
+        return Entries(base,
+                       flat::load<std::uint32_t>(base, slot),
+                       flat::load<std::uint32_t>(base, slot + 4));
+    }
+
+    static T load(char const* base, std::size_t slot) {
+        auto at = flat::load<std::uint32_t>(base, slot);
+        auto const n = flat::load<std::uint32_t>(base, slot + 4);
+        T ret;
+        for (std::uint32_t i = 0; i < n; ++i, at += Entries::stride) {
+            ret.emplace(FlatImpl<K>::load(base, at),
+                        FlatImpl<V>::load(base, at + FlatImpl<K>::size));
+        }
+        return ret;
+    }
+};
+
+
+template <typename T>
+class View;
+
+
+/// Reflected structs, a table of slots
+template <typename T>
+struct FlatImpl<T, When<boost::hana::Struct<T>::value>> {
+    template <typename Get>
+    using Field = std::decay_t<decltype(std::declval<Get>()(std::declval<T&>()))>;
+
+    /// Offset of the `i`-th field slot within the table
+    static constexpr std::size_t offset(std::size_t i) {
+        std::size_t ret = 0;
+        std::size_t n = 0;
+        boost::hana::for_each(boost::hana::accessors<T>(),
+                              boost::hana::fuse([&](auto, auto get) {
+            if (n++ < i) { ret += FlatImpl<Field<decltype(get)>>::size; }
+        }));
+        return ret;
+    }
+
+    static constexpr std::size_t size =
+            offset(boost::hana::length(boost::hana::accessors<T>()));
+
+    static void write(Builder& b, std::size_t slot, T const& x) {
+        boost::hana::for_each(boost::hana::accessors<T>(),
+                              boost::hana::fuse([&](auto, auto get) {
+            using F = Field<decltype(get)>;
+            FlatImpl<F>::write(b, slot, get(x));
+            slot += FlatImpl<F>::size;
+        }));
+    }
+
+    static View<T> view(char const* base, std::size_t slot) noexcept {
+        return View<T>(base, slot);
+    }
+
+    static T load(char const* base, std::size_t slot) {
+        T ret;
+        boost::hana::for_each(boost::hana::accessors<T>(),
+                              boost::hana::fuse([&](auto, auto get) {
+            using F = Field<decltype(get)>;
+            get(ret) = FlatImpl<F>::load(base, slot);
+            slot += FlatImpl<F>::size;
+        }));
+        return ret;
+    }
+
+    static constexpr std::uint64_t schema() {
+        return hashCombine(fnv1a("flat"), BinaryImpl<T>::schema());
+    }
+};
+
+
+///
+/// Read-only accessor of a flat struct
+///
+/// Fields are addressed by their names as hana strings:
+///     `view["name"_s]`
+/// and are returned as values for arithmetic types, `std::string_view` for
+/// strings, `Vector`/`Map` for containers, `std::optional` for optionals and
+/// `View` for nested structs.
+///
+template <typename T>
+class View {
+public:
+    View(char const* base, std::size_t at) noexcept : base(base), at(at) {}
+
+    template <typename Name>
+    auto operator[](Name) const {
+        using Accessors = decltype(boost::hana::accessors<T>());
+        using Found = decltype(boost::hana::index_if(
+            std::declval<Accessors>(),
+            boost::hana::compose(boost::hana::equal.to(Name()),
+                                 boost::hana::first)));
+        static_assert(decltype(boost::hana::is_just(std::declval<Found>()))::value,
+                      "No such field");
+        constexpr std::size_t i =
+                std::decay_t<decltype(*std::declval<Found>())>::value;
+        using Get = std::decay_t<decltype(boost::hana::second(
+            boost::hana::at_c<i>(std::declval<Accessors>())))>;
+        using F = typename FlatImpl<T>::template Field<Get>;
+        return FlatImpl<F>::view(base, at + FlatImpl<T>::offset(i));
+    }
+
+    /// Copy the whole struct out
+    T load() const { return FlatImpl<T>::load(base, at); }
+
+private:
+    char const* base;
+    std::size_t at;
+};
+
+
+/// Lay out `x` in a flat buffer
+template <typename T>
+std::string build(T const& x) {
+    Builder b;
+    b.allocate(header_size + FlatImpl<T>::size);
+    b.put(0, static_cast<std::uint64_t>(FlatImpl<T>::schema()));
+    FlatImpl<T>::write(b, header_size, x);
+    return std::move(b.buf);
+}
+
+
+/// Access a buffer produced by `build`, the buffer must outlive the view
+/// \throw `FlatError` if the buffer is too short or has another schema
+template <typename T>
+View<T> view(std::string_view buffer) {
+    if (buffer.size() < header_size + FlatImpl<T>::size) {
+        throw FlatError("buffer is too short");
+    }
+    if (flat::load<std::uint64_t>(buffer.data(), 0) != FlatImpl<T>::schema()) {
+        throw FlatError("schema fingerprint mismatch");
+    }
+    return View<T>(buffer.data(), header_size);
+}
+
+
+///
+/// Read-only memory mapped file
+///
+class MappedFile {
+public:
+    /// \throw `std::system_error`
+    explicit MappedFile(std::string const& path);
+    ~MappedFile();
+
+    MappedFile(MappedFile const&) = delete;
+    MappedFile& operator=(MappedFile const&) = delete;
+
+    MappedFile(MappedFile&& rhs) noexcept;
+    MappedFile& operator=(MappedFile&& rhs) noexcept;
+
+    std::string_view data() const noexcept {
+        return std::string_view(static_cast<char const*>(addr), size);
+    }
+
+private:
+    void* addr{nullptr};
+    std::size_t size{0};
+};
+
+
+}
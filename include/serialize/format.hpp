@@ -0,0 +1,166 @@
+/*
+  MIT License
+
+  Copyright (c) 2018 Nicolai Trandafil
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#pragma once
+
+
+// local
+#include <serialize/meta.hpp>
+#include <serialize/when.hpp>
+
+// std
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+
+/// \file
+/// Text formatting appending to a `std::string`
+///
+/// `appendTo(out, x)` writes what `std::ostream& << x` prints with the
+/// default flags, numbers through `std::to_chars`. Types with a member
+/// `appendTo(std::string&) const` and `trait::OStream` structs are written
+/// directly. Other types fall back to their `operator<<`.
+
+
+namespace serialize {
+
+
+namespace detail {
+
+
+/// Appends `std::to_chars(..., args...)` of `x`
+template <typename T, typename... Args>
+void appendChars(std::string& out, T x, Args... args) {
+    // fixed notation of the largest double
+    char buf[std::numeric_limits<double>::max_exponent10 + 32];
+    auto const res = std::to_chars(std::begin(buf), std::end(buf), x, args...);
+    out.append(buf, res.ptr);
+}
+
+
+template <typename T>
+constexpr bool is_character_v = std::is_same_v<T, char> ||
+                                std::is_same_v<T, signed char> ||
+                                std::is_same_v<T, unsigned char>;
+
+
+/// Left to `operator<<`, `std::to_chars` does not take them
+template <typename T>
+constexpr bool is_wide_character_v = std::is_same_v<T, wchar_t> ||
+                                     std::is_same_v<T, char16_t> ||
+                                     std::is_same_v<T, char32_t>;
+
+
+} // namespace detail
+
+
+/// Formatting implementation
+template <typename T, typename = void>
+struct AppendImpl : AppendImpl<T, When<true>> {};
+
+
+/// Fall back
+template <typename T, bool condition>
+struct AppendImpl<T, When<condition>> {
+    static void apply(std::string& out, T const& x) {
+        std::ostringstream os;
+        os << x;
+        out += os.str();
+    }
+};
+
+
+/// Appends the text of `x` to `out`
+template <typename T>
+void appendTo(std::string& out, T const& x) {
+    AppendImpl<T>::apply(out, x);
+}
+
+
+/// Writes the text of `x` to `out`
+template <typename OutputIt, typename T>
+OutputIt formatTo(OutputIt out, T const& x) {
+    std::string buf;
+    appendTo(buf, x);
+    return std::copy(buf.begin(), buf.end(), out);
+}
+
+
+/// Printed as `1` or `0`
+template <>
+struct AppendImpl<bool> {
+    static void apply(std::string& out, bool x) { out += x ? '1' : '0'; }
+};
+
+
+/// Printed as characters
+template <typename T>
+struct AppendImpl<T, When<detail::is_character_v<T>>> {
+    static void apply(std::string& out, T x) { out += char(x); }
+};
+
+
+/// Printed in decimal
+template <typename T>
+struct AppendImpl<T, When<std::is_integral_v<T> &&
+                          !std::is_same_v<T, bool> &&
+                          !detail::is_character_v<T> &&
+                          !detail::is_wide_character_v<T>>> {
+    static void apply(std::string& out, T x) { detail::appendChars(out, x); }
+};
+
+
+/// Six significant digits, as `%g`
+template <typename T>
+struct AppendImpl<T, When<std::is_floating_point_v<T>>> {
+    static void apply(std::string& out, T x) {
+        detail::appendChars(out, x, std::chars_format::general, 6);
+    }
+};
+
+
+template <typename T>
+struct AppendImpl<T, When<std::is_convertible_v<T const&, std::string_view>>> {
+    static void apply(std::string& out, T const& x) {
+        out += std::string_view(x);
+    }
+};
+
+
+/// Types formatting themselves
+template <typename T>
+struct AppendImpl<T, When<detail::Valid<decltype(
+        std::declval<T const&>().appendTo(std::declval<std::string&>()))>::value>> {
+    static void apply(std::string& out, T const& x) { x.appendTo(out); }
+};
+
+
+}
@@ -236,6 +236,33 @@ constexpr auto hasEmplace = boost::hana::is_valid([](auto x) ->
 {});
 
 
+constexpr auto hasReserve = boost::hana::is_valid([](auto x) ->
+    decltype((void) boost::hana::traits::declval(x).reserve(std::size_t()))
+{});
+
+
+constexpr auto hasSize = boost::hana::is_valid([](auto x) ->
+    decltype((void) boost::hana::traits::declval(x).size())
+{});
+
+
+constexpr auto hasResize = boost::hana::is_valid([](auto x) ->
+    decltype((void) boost::hana::traits::declval(x).resize(std::size_t()))
+{});
+
+
+/// `x` as an rvalue when its owner, typed `Owner`, is an rvalue
+/// Moves elements or members out of expiring containers and structs
+template <typename Owner, typename T>
+constexpr decltype(auto) forwardLike(T& x) noexcept {
+    if constexpr (std::is_lvalue_reference_v<Owner>) {
+        return static_cast<T const&>(x);
+    } else {
+        return std::move(x);
+    }
+}
+
+
 #if SERIALIZE_ENABLE_TYPE_SAFE
 template <typename T>
 struct StrongTypeDefImpl {
@@ -0,0 +1,67 @@
+/*
+  MIT License
+
+  Copyright (c) 2018 Nicolai Trandafil
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#pragma once
+
+
+// std
+#include <cstddef>
+
+
+/// \file node_pool.hpp
+/// Thread caches of small blocks, the storage of `Variant` nodes
+
+
+namespace serialize {
+
+
+///
+/// Allocator of small blocks kept in per thread free lists by size class
+///
+/// A block freed by the thread which allocated it goes back to its cache,
+/// one freed by another thread is pushed lock free on a list of the owner,
+/// which takes it back once its own cache is empty. The caches of exited
+/// threads are adopted by new ones. Blocks above `max_size` and the
+/// overflow of a full cache go to the heap.
+///
+class NodePool {
+public:
+    static constexpr std::size_t max_size = 256;
+
+    /// \throw `std::bad_alloc`
+    static void* allocate(std::size_t size);
+
+    /// `size` as given to `allocate`
+    static void deallocate(void* p, std::size_t size) noexcept;
+
+    /// Return the blocks cached by the calling thread to the heap
+    static void trim() noexcept;
+
+    /// Number of blocks cached by the calling thread
+    static std::size_t cached() noexcept;
+};
+
+
+}
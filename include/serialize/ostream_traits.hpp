@@ -27,6 +27,7 @@
 
 
 // local
+#include <serialize/format.hpp>
 #include <serialize/meta.hpp>
 #include <serialize/type_name.hpp>
 
@@ -34,62 +35,129 @@
 #include <boost/hana.hpp>
 
 // std
-#include <iomanip>
 #include <ostream>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+
+namespace serialize::detail {
+
+
+/// Puts the fields of `x` through `put`, as `Type { name: value; ... }`
+template <typename T, typename Put>
+void putFields(T const& x, Put&& put) {
+    put(unqualifiedTypeName<T>());
+    put(" { ");
+
+    boost::hana::for_each(x, boost::hana::fuse([&](auto name, auto const& value) {
+        using Value = std::decay_t<decltype(value)>;
+        if constexpr (isOptional(type_c<Value>)) {
+            if (value.has_value()) {
+                put(boost::hana::to<char const*>(name));
+                put(": ");
+                put(*value);
+                put("; ");
+            }
+        } else if constexpr (isContainer(type_c<Value>)) {
+            put(boost::hana::to<char const*>(name));
+            if constexpr (isKeyValue(type_c<typename Value::value_type>)) {
+                put(": { ");
+                for (auto const& x: value) {
+                    put(x.first);
+                    put(": ");
+                    put(x.second);
+                    put("; ");
+                }
+                put("}; ");
+            } else {
+                put(": [");
+                auto first = true;
+                for (auto const& x: value) {
+                    if (!first) { put(", "); }
+                    first = false;
+                    put(x);
+                }
+                put("]; ");
+            }
+        }
+#if SERIALIZE_ENABLE_TYPE_SAFE
+        else if constexpr (strongTypeDef(type_c<T>)) {
+            put(static_cast<type_safe::underlying_type<T>>(x));
+        }
+#endif
+        else {
+            put(boost::hana::to<char const*>(name));
+            put(": ");
+            put(value);
+            put("; ");
+        }
+    }));
+
+    put("}");
+}
+
+
+template <typename T, typename = void>
+struct IsStreamable : std::false_type {};
+
+
+template <typename T>
+struct IsStreamable<T, std::void_t<decltype(
+        std::declval<std::ostream&>() << std::declval<T const&>())>>
+    : std::true_type {};
+
+
+} // namespace serialize::detail
 
 
 namespace serialize::trait {
 
 
 /// Enables `ostreams` for `Derived`
+///
+/// With the default stream state the struct is formatted with `appendTo`
+/// and written at once. Otherwise every member is streamed, honouring the
+/// flags and precision; the width applies to the type name only, as it
+/// would to the first item of any `<<` chain, not to each member.
 template <typename Derived>
 struct OStream {
     friend std::ostream& operator<<(std::ostream& os, Derived const& x) {
-        os << unqualifiedTypeName<Derived>() << " { ";
-
-        boost::hana::for_each(x, boost::hana::fuse([&](auto name, auto value) {
-            if constexpr (isOptional(type_c<decltype(value)>)) {
-                if (value.has_value()) {
-                    os << boost::hana::to<char const*>(name)
-                       << ": "
-                       << *value
-                       << "; ";
-                }
-            } else if constexpr (isContainer(type_c<decltype(value)>)) {
-                os << boost::hana::to<char const*>(name);
-                if constexpr (isKeyValue(type_c<typename decltype(value)::value_type>)) {
-                    os << ": { ";
-                    for (auto const& x: value) {
-                        os << x.first
-                           << ": "
-                           << x.second
-                           << "; ";
-                    }
-                    os << "}; ";
-                } else {
-                    auto const s = value.size();
-                    std::size_t i = 0;
-                    os << ": [";
-                    for (auto const& x: value) {
-                        os << x << ((i++ == s - 1) ? "" : ", ");
-                    }
-                    os << "]; ";
-                }
-            } else if constexpr (strongTypeDef(type_c<Derived>)) {
-                os << static_cast<type_safe::underlying_type<Derived>>(x);
+        if (os.flags() == (std::ios_base::dec | std::ios_base::skipws) &&
+                os.precision() == 6 && os.width() == 0) {
+            std::string out;
+            appendTo(out, x);
+            return os.write(out.data(), std::streamsize(out.size()));
+        }
+
+        serialize::detail::putFields(x, [&](auto const& value) {
+            using Value = std::decay_t<decltype(value)>;
+            if constexpr (serialize::detail::IsStreamable<Value>::value) {
+                os << value;
             } else {
-                os << boost::hana::to<char const*>(name)
-                   << ": "
-                   << value
-                   << "; ";
+                std::string out;
+                appendTo(out, value);
+                os.write(out.data(), std::streamsize(out.size()));
             }
-        }));
-
-        os << "}";
+        });
 
         return os;
     }
 };
 
 
+}
+
+
+namespace serialize {
+
+
+template <typename T>
+struct AppendImpl<T, When<std::is_base_of_v<trait::OStream<T>, T>>> {
+    static void apply(std::string& out, T const& x) {
+        detail::putFields(x, [&](auto const& value) { appendTo(out, value); });
+    }
+};
+
+
 }
@@ -0,0 +1,125 @@
+/*
+  MIT License
+
+  Copyright (c) 2018 Nicolai Trandafil
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#pragma once
+
+
+// local
+#include <serialize/variant.hpp>
+
+// std
+#include <stdexcept>
+#include <string>
+
+
+/// \file patch.hpp
+/// Structural diff and patch of `Variant` trees
+///
+/// Two patch formats are supported:
+///     - RFC 6902 JSON Patch, a vector of operations like
+///       `{op: "replace", path: "/points/1/x", value: 3}`;
+///     - RFC 7386 JSON Merge Patch, a map overlaid on the target, null
+///       values removing members.
+///
+/// `merge` generalizes the latter to layering configurations, with a
+/// `MergePolicy` choosing how vectors and empty values combine.
+///
+/// The diff skips identical subtrees by their structural hashes, so its
+/// output and the work of applying it scale with the size of the change.
+
+
+namespace serialize {
+
+
+class PatchError : public std::runtime_error {
+public:
+    explicit PatchError(std::string const& x) : runtime_error("Patch: " + x) {}
+};
+
+
+/// JSON Patch turning `a` into `b`, made of `add`, `remove` and `replace`
+Variant diff(Variant const& a, Variant const& b);
+
+
+/// JSON Merge Patch turning `a` into `b`
+///
+/// Empty values in `b` can not be expressed, as in RFC 7386
+Variant mergeDiff(Variant const& a, Variant const& b);
+
+
+///
+/// Apply the JSON Patch `patch` to `x` in place
+///
+/// Supports all the operations of RFC 6902. The operations are applied in
+/// order, on error `x` keeps the ones applied before.
+/// \throw `PatchError` on an invalid operation or a failed `test`
+///
+void applyPatch(Variant& x, Variant const& patch);
+
+/// As above, moving the values out of `patch`
+void applyPatch(Variant& x, Variant&& patch);
+
+
+/// Apply the JSON Merge Patch `patch` to `x` in place
+void applyMergePatch(Variant& x, Variant const& patch);
+
+/// As above, moving the values out of `patch`
+void applyMergePatch(Variant& x, Variant&& patch);
+
+
+/// How `merge` combines an overlay with its base
+struct MergePolicy {
+    enum class Arrays {
+        replace, ///< the overlay vector replaces the base one
+        concat   ///< the overlay vector is appended to the base one
+    };
+
+    enum class Nulls {
+        remove, ///< an empty value removes the member, as in RFC 7386
+        assign, ///< an empty value is assigned like any other
+        skip    ///< an empty value keeps the base member
+    };
+
+    Arrays arrays{Arrays::replace};
+    Nulls nulls{Nulls::remove};
+};
+
+
+///
+/// Overlay `overlay` on `base` in place
+///
+/// Maps are merged recursively, other values replace those of `base`
+/// unless `policy` says otherwise. With the default policy this is
+/// `applyMergePatch`.
+///
+void merge(Variant& base, Variant const& overlay,
+           MergePolicy const& policy = {});
+
+/// As above, moving the subtrees out of `overlay`, so that the cost is
+/// bound by the size of `overlay` and not by that of `base`
+void merge(Variant& base, Variant&& overlay, MergePolicy const& policy = {});
+
+
+}
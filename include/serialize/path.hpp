@@ -0,0 +1,138 @@
+/*
+  MIT License
+
+  Copyright (c) 2018 Nicolai Trandafil
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#pragma once
+
+
+// local
+#include <serialize/string_map.hpp>
+#include <serialize/variant.hpp>
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+/// \file path.hpp
+/// Compiled paths to values nested in a `Variant`
+///
+/// A path is parsed once, from RFC 6901 JSON Pointer (`/points/1/x`) or from
+/// the dotted syntax (`points[1].x` or `points.1.x`), into steps holding the
+/// hashed key and the parsed index. A step is applied as a key to maps and
+/// as an index to vectors, like a JSON Pointer reference token.
+
+
+namespace serialize {
+
+
+class PathError : public std::runtime_error {
+public:
+    explicit PathError(std::string const& x) : runtime_error("Path: " + x) {}
+};
+
+
+class Path {
+public:
+    static constexpr std::size_t no_index = std::numeric_limits<std::size_t>::max();
+
+    struct Step {
+        std::string key;
+        std::uint64_t hash{0};
+
+        /// The key as an array index, `no_index` if it is not one
+        std::size_t index{no_index};
+
+        PrehashedKey prehashed() const noexcept { return {key, hash}; }
+    };
+
+    /// The root
+    Path() = default;
+
+    /// \throw `PathError` on malformed `x`
+    static Path pointer(std::string_view x);
+
+    /// \throw `PathError` on malformed `x`
+    static Path dotted(std::string_view x);
+
+    /// Append a key step
+    Path& push(std::string key);
+
+    std::vector<Step> const& steps() const noexcept { return m; }
+    bool empty() const noexcept { return m.empty(); }
+
+    /// RFC 6901 form
+    std::string str() const;
+
+    /// The value at `step` of `x`, nullptr if there is none
+    static Variant const* child(Variant const& x, Step const& step) noexcept;
+
+    bool operator==(Path const& rhs) const noexcept;
+
+private:
+    std::vector<Step> m;
+};
+
+
+///
+/// Paths compiled together, sharing their common prefixes
+///
+/// Extraction resolves each distinct prefix once
+///
+class PathSet {
+public:
+    explicit PathSet(std::vector<Path> const& paths);
+
+    std::size_t size() const noexcept { return count; }
+
+    /// Values at each path in order, nullptr where there is none
+    std::vector<Variant const*> extract(Variant const& x) const;
+
+    /// As above, into `out`, reusing its storage
+    void extract(Variant const& x, std::vector<Variant const*>& out) const;
+
+private:
+    struct Node {
+        Path::Step step;
+        std::vector<std::size_t> children;
+
+        /// Indexes of the paths ending here
+        std::vector<std::size_t> ends;
+    };
+
+    void walk(std::size_t node, Variant const* x,
+              std::vector<Variant const*>& out) const;
+
+    /// The root is the node 0
+    std::vector<Node> nodes;
+    std::size_t count{0};
+};
+
+
+}
@@ -0,0 +1,602 @@
+/*
+  MIT License
+
+  Copyright (c) 2018 Nicolai Trandafil
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#pragma once
+
+
+// local
+#include <serialize/binary.hpp>
+#include <serialize/meta.hpp>
+#include <serialize/variant.hpp>
+#include <serialize/variant_conversion.hpp>
+#include <serialize/when.hpp>
+
+// boost
+#include <boost/hana.hpp>
+
+// std
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+
+/// \file protobuf.hpp
+/// Protocol Buffers wire format for reflected structs
+///
+/// A `BOOST_HANA_ADAPT_STRUCT` is a message. Field numbers follow the
+/// declaration order starting from 1, unless overridden by a static member
+/// function `fieldNumbers()` returning a hana map from member names to
+/// `boost::hana::int_c<N>`. Types map to the protobuf scalar types:
+///     - `bool`, integers and enums are varints, signed ones are `int32` /
+///       `int64` (sign extended, not zigzag);
+///     - `float` is `fixed32`, `double` is `fixed64`;
+///     - strings are `string` / `bytes`;
+///     - reflected structs are embedded messages;
+///     - sequences are `repeated`, packed for numeric elements;
+///     - associative containers are `map` (entries with key 1 and value 2);
+///     - `std::optional` has explicit presence, other singular fields are
+///       skipped when zero or empty;
+///     - any other type goes through `Variant` as CBOR `bytes`.
+///
+/// Decoding accepts both packed and unpacked repeated numbers and skips
+/// unknown fields; groups are not supported.
+
+
+namespace serialize {
+
+
+/// Protobuf decoding error
+class ProtobufError : public std::runtime_error {
+public:
+    explicit ProtobufError(std::string const& x)
+        : runtime_error("Protobuf: " + x) {}
+};
+
+
+namespace protobuf {
+
+
+enum class WireType : std::uint8_t {
+    varint = 0,
+    fixed64 = 1,
+    length = 2,
+    fixed32 = 5
+};
+
+
+constexpr std::uint32_t max_field_number = (1u << 29) - 1;
+
+
+inline void putTag(std::string& out, std::uint32_t number, WireType wire) {
+    binary::putVarint(out, (std::uint64_t(number) << 3) | std::uint64_t(wire));
+}
+
+
+/// Append the varint length of what `f` writes in front of it, without a
+/// temporary buffer
+template <typename F>
+void putLengthDelimited(std::string& out, F&& f) {
+    auto const at = out.size();
+    out.push_back('\0');
+    f();
+    auto const n = out.size() - at - 1;
+    if (n < 0x80) {
+        out[at] = static_cast<char>(n);
+    } else {
+        std::string prefix;
+        binary::putVarint(prefix, n);
+        out.replace(at, 1, prefix);
+    }
+}
+
+
+/// Skip the value of an unknown field
+inline void skip(binary::Input& in, WireType wire) {
+    switch (wire) {
+    case WireType::varint: in.varint(); return;
+    case WireType::fixed64: in.bytes(8); return;
+    case WireType::length: in.bytes(in.size()); return;
+    case WireType::fixed32: in.bytes(4); return;
+    }
+    throw ProtobufError("unsupported wire type");
+}
+
+
+/// Call `f(number, wire)` for every field key of a message body; `f` has to
+/// consume the value
+template <typename F>
+void forEachField(binary::Input& in, F&& f) {
+    while (in.left() != 0) {
+        auto const key = in.varint();
+        auto const number = key >> 3;
+        auto const wire = key & 7;
+        if (number == 0 || number > max_field_number) {
+            throw ProtobufError("invalid field number");
+        }
+        if (wire == 3 || wire == 4 || wire > 5) {
+            throw ProtobufError("unsupported wire type");
+        }
+        f(static_cast<std::uint32_t>(number), static_cast<WireType>(wire));
+    }
+}
+
+
+/// Is there a `fieldNumbers()` annotation in the struct
+constexpr auto const hasFieldNumbers = boost::hana::is_valid(
+    [](auto t) -> decltype((void) decltype(t)::type::fieldNumbers()) {});
+
+
+/// Number of the member `Name` of `T` from `fieldNumbers()` or `fallback`
+template <typename T, typename Name>
+constexpr std::uint32_t annotatedNumber(std::uint32_t fallback) {
+    if constexpr (hasFieldNumbers(boost::hana::type_c<T>)) {
+        using Map = decltype(T::fieldNumbers());
+        if constexpr (decltype(boost::hana::contains(
+                std::declval<Map>(), std::declval<Name>()))::value) {
+            return std::decay_t<decltype(
+                std::declval<Map>()[std::declval<Name>()])>::value;
+        } else {
+            return fallback;
+        }
+    } else {
+        return fallback;
+    }
+}
+
+
+/// Field numbers of the members of `T` in declaration order
+template <typename T>
+constexpr auto fieldNumbers() {
+    constexpr std::size_t size = decltype(
+        boost::hana::length(boost::hana::accessors<T>()))::value;
+    std::array<std::uint32_t, size> ret{};
+    std::size_t i = 0;
+    boost::hana::for_each(boost::hana::accessors<T>(),
+                          boost::hana::fuse([&](auto name, auto) {
+        ret[i] = annotatedNumber<T, decltype(name)>(
+            static_cast<std::uint32_t>(i + 1));
+        ++i;
+    }));
+    return ret;
+}
+
+
+template <std::size_t N>
+constexpr bool validFieldNumbers(std::array<std::uint32_t, N> const& x) {
+    for (std::size_t i = 0; i < N; ++i) {
+        if (x[i] == 0 || x[i] > max_field_number ||
+                (x[i] >= 19000 && x[i] <= 19999)) {
+            return false;
+        }
+        for (std::size_t j = 0; j < i; ++j) {
+            if (x[j] == x[i]) { return false; }
+        }
+    }
+    return true;
+}
+
+
+} // namespace protobuf
+
+
+/// Protobuf encoding of a singular value of `T`
+/// Provides the `wire` type, `write(std::string&, T)` of the value without the
+/// tag, `read(binary::Input&)` and `zero(T)` telling whether the value may be
+/// omitted
+template <typename T, typename = void>
+struct ProtobufImpl : ProtobufImpl<T, When<true>> {};
+
+
+/// Fallback through `Variant`, the CBOR encoding as `bytes`
+///
+/// Not `BinaryImpl`, whose containers start with a count, not a length
+template <typename T, bool condition>
+struct ProtobufImpl<T, When<condition>> {
+    static constexpr auto wire = protobuf::WireType::length;
+
+    static void write(std::string& out, T const& x) {
+        std::string cbor;
+        if constexpr (std::is_same_v<T, Variant>) {
+            cbor = x.toCbor();
+        } else {
+            cbor = toVariant(x).toCbor();
+        }
+        binary::putVarint(out, cbor.size());
+        out += cbor;
+    }
+
+    static T read(binary::Input& in) {
+        auto var = Variant::fromCbor(in.bytes(in.size()));
+        if constexpr (std::is_same_v<T, Variant>) {
+            return var;
+        } else {
+            return fromVariant<T>(var);
+        }
+    }
+
+    static bool zero(T const&) { return false; }
+};
+
+
+template <>
+struct ProtobufImpl<bool> {
+    static constexpr auto wire = protobuf::WireType::varint;
+
+    static void write(std::string& out, bool x) {
+        out.push_back(static_cast<char>(x));
+    }
+
+    static bool read(binary::Input& in) { return in.varint() != 0; }
+
+    static bool zero(bool x) { return !x; }
+};
+
+
+/// `int32`, `int64`, `uint32`, `uint64` and enums
+template <typename T>
+struct ProtobufImpl<T, When<
+        (std::is_integral_v<T> && !std::is_same_v<T, bool>) ||
+        std::is_enum_v<T>>> {
+    static constexpr auto wire = protobuf::WireType::varint;
+
+    using U = std::conditional_t<std::is_enum_v<T>,
+                                 std::underlying_type<T>,
+                                 std::common_type<T>>;
+    using Int = typename U::type;
+
+    static void write(std::string& out, T x) {
+        if constexpr (std::is_signed_v<Int>) {
+            binary::putVarint(out, static_cast<std::uint64_t>(
+                static_cast<std::int64_t>(x)));
+        } else {
+            binary::putVarint(out, static_cast<Int>(x));
+        }
+    }
+
+    static T read(binary::Input& in) {
+        auto const x = in.varint();
+
+#if __GNUG__
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wsign-compare" // safe comparation
+
+        if constexpr (std::is_signed_v<Int>) {
+            auto const y = static_cast<std::int64_t>(x);
+            if (y < std::numeric_limits<Int>::min() ||
+                    y > std::numeric_limits<Int>::max()) {
+                throw ProtobufError("integral overflow");
+            }
+            return static_cast<T>(y);
+        } else {
+            if (x > std::numeric_limits<Int>::max()) {
+                throw ProtobufError("integral overflow");
+            }
+            return static_cast<T>(x);
+        }
+
+#pragma GCC diagnostic pop
+#else
+#error The compiler not supported
+#endif
+
+    }
+
+    static bool zero(T x) { return x == T{}; }
+};
+
+
+/// `float` and `double`
+template <typename T>
+struct ProtobufImpl<T, When<std::is_floating_point_v<T>>> {
+    static_assert(sizeof(T) == 4 || sizeof(T) == 8,
+                  "Unsupported floating point type");
+
+    static constexpr auto wire = sizeof(T) == 4 ? protobuf::WireType::fixed32
+                                                : protobuf::WireType::fixed64;
+
+    static void write(std::string& out, T x) { BinaryImpl<T>::write(out, x); }
+
+    static T read(binary::Input& in) { return BinaryImpl<T>::read(in); }
+
+    static bool zero(T x) {
+        // negative zero is not the default
+        T const z{0};
+        return std::memcmp(&x, &z, sizeof(T)) == 0;
+    }
+};
+
+
+template <typename T>
+struct ProtobufImpl<T, When<isString(type_c<T>)>> {
+    static constexpr auto wire = protobuf::WireType::length;
+
+    static void write(std::string& out, T const& x) {
+        BinaryImpl<T>::write(out, x);
+    }
+
+    static T read(binary::Input& in) { return BinaryImpl<T>::read(in); }
+
+    static bool zero(T const& x) { return x.empty(); }
+};
+
+
+/// Protobuf encoding of a struct member of type `T` with its tag
+/// Provides `write(std::string&, number, T)` and
+/// `read(binary::Input&, WireType, T&)` merging one occurrence of the field
+template <typename T, typename = void>
+struct ProtobufField : ProtobufField<T, When<true>> {};
+
+
+/// Singular field, implicit presence
+template <typename T, bool condition>
+struct ProtobufField<T, When<condition>> {
+    using Impl = ProtobufImpl<T>;
+
+    static void write(std::string& out, std::uint32_t number, T const& x) {
+        if (Impl::zero(x)) { return; }
+        protobuf::putTag(out, number, Impl::wire);
+        Impl::write(out, x);
+    }
+
+    static void read(binary::Input& in, protobuf::WireType wire, T& x) {
+        if (wire != Impl::wire) { throw ProtobufError("wire type mismatch"); }
+        if constexpr (boost::hana::Struct<T>::value) {
+            Impl::merge(in, x);
+        } else {
+            x = Impl::read(in);
+        }
+    }
+};
+
+
+/// Singular field, explicit presence
+template <typename T>
+struct ProtobufField<T, When<isOptional(type_c<T>)>> {
+    using U = typename T::value_type;
+    using Impl = ProtobufImpl<U>;
+
+    static void write(std::string& out, std::uint32_t number, T const& x) {
+        if (!x) { return; }
+        protobuf::putTag(out, number, Impl::wire);
+        Impl::write(out, *x);
+    }
+
+    static void read(binary::Input& in, protobuf::WireType wire, T& x) {
+        if (x) {
+            ProtobufField<U>::read(in, wire, *x);
+        } else {
+            if (wire != Impl::wire) { throw ProtobufError("wire type mismatch"); }
+            x = Impl::read(in);
+        }
+    }
+};
+
+
+/// `repeated`, packed when the elements are numbers
+template <typename T>
+struct ProtobufField<T, When<
+        isContainer(type_c<T>) &&
+        !binary::hasMappedType(boost::hana::type_c<T>) &&
+        (hasPushBack(boost::hana::type_c<T>) ||
+         hasEmplace(boost::hana::type_c<T>))>> {
+    using U = typename T::value_type;
+    using Impl = ProtobufImpl<U>;
+
+    static constexpr bool packed = Impl::wire != protobuf::WireType::length;
+
+    static void write(std::string& out, std::uint32_t number, T const& x) {
+        if (std::empty(x)) { return; }
+        if constexpr (packed) {
+            protobuf::putTag(out, number, protobuf::WireType::length);
+            protobuf::putLengthDelimited(out, [&] {
+                for (auto const& v: x) { Impl::write(out, v); }
+            });
+        } else {
+            for (auto const& v: x) {
+                protobuf::putTag(out, number, Impl::wire);
+                Impl::write(out, v);
+            }
+        }
+    }
+
+    static void read(binary::Input& in, protobuf::WireType wire, T& x) {
+        if (packed && wire == protobuf::WireType::length) {
+            binary::Input packed_in(in.bytes(in.size()));
+            while (packed_in.left() != 0) { add(x, Impl::read(packed_in)); }
+        } else {
+            if (wire != Impl::wire) { throw ProtobufError("wire type mismatch"); }
+            add(x, Impl::read(in));
+        }
+    }
+
+    static void add(T& x, U&& v) {
+        if constexpr (hasPushBack(boost::hana::type_c<T>)) {
+            x.push_back(std::move(v));
+        } else {
+            x.emplace(std::move(v));
+        }
+    }
+};
+
+
+/// `map<K, V>`, entries are embedded messages with the key 1 and value 2
+template <typename T>
+struct ProtobufField<T, When<
+        isContainer(type_c<T>) &&
+        binary::hasMappedType(boost::hana::type_c<T>)>> {
+    using K = std::decay_t<typename T::key_type>;
+    using V = typename T::mapped_type;
+
+    static void write(std::string& out, std::uint32_t number, T const& x) {
+        for (auto const& v: x) {
+            protobuf::putTag(out, number, protobuf::WireType::length);
+            protobuf::putLengthDelimited(out, [&] {
+                ProtobufField<K>::write(out, 1, v.first);
+                ProtobufField<V>::write(out, 2, v.second);
+            });
+        }
+    }
+
+    static void read(binary::Input& in, protobuf::WireType wire, T& x) {
+        if (wire != protobuf::WireType::length) {
+            throw ProtobufError("wire type mismatch");
+        }
+        binary::Input entry(in.bytes(in.size()));
+        K key{};
+        V value{};
+        if constexpr (boost::hana::Struct<V>::value) {
+            ProtobufImpl<V>::clear(value);
+        }
+        protobuf::forEachField(entry, [&](auto number, auto field_wire) {
+            if (number == 1) {
+                ProtobufField<K>::read(entry, field_wire, key);
+            } else if (number == 2) {
+                ProtobufField<V>::read(entry, field_wire, value);
+            } else {
+                protobuf::skip(entry, field_wire);
+            }
+        });
+        x[std::move(key)] = std::move(value);
+    }
+};
+
+
+/// Embedded messages
+template <typename T>
+struct ProtobufImpl<T, When<boost::hana::Struct<T>::value>> {
+    static constexpr auto wire = protobuf::WireType::length;
+
+    template <typename Get>
+    using Field = std::decay_t<decltype(std::declval<Get>()(std::declval<T&>()))>;
+
+    /// Field numbers in declaration order
+    static constexpr auto numbers = protobuf::fieldNumbers<T>();
+
+    static_assert(protobuf::validFieldNumbers(numbers),
+                  "Protobuf field numbers must be unique, in [1, 2^29 - 1] "
+                  "and outside of the reserved range [19000, 19999]");
+
+    /// Set every field to its protobuf default, zero or empty
+    static void clear(T& x) {
+        boost::hana::for_each(boost::hana::accessors<T>(),
+                              boost::hana::fuse([&](auto, auto get) {
+            using F = Field<decltype(get)>;
+            if constexpr (boost::hana::Struct<F>::value) {
+                ProtobufImpl<F>::clear(get(x));
+            } else {
+                get(x) = F{};
+            }
+        }));
+    }
+
+    /// Encode the fields without the length prefix
+    static void writeBody(std::string& out, T const& x) {
+        std::size_t i = 0;
+        boost::hana::for_each(boost::hana::accessors<T>(),
+                              boost::hana::fuse([&](auto, auto get) {
+            ProtobufField<Field<decltype(get)>>::write(out, numbers[i++], get(x));
+        }));
+    }
+
+    static void write(std::string& out, T const& x) {
+        protobuf::putLengthDelimited(out, [&] { writeBody(out, x); });
+    }
+
+    /// Merge the fields of a message body into `x`
+    static void mergeBody(binary::Input& in, T& x) {
+        protobuf::forEachField(in, [&](auto number, auto wire) {
+            std::size_t i = 0;
+            bool found = false;
+            boost::hana::for_each(boost::hana::accessors<T>(),
+                                  boost::hana::fuse([&](auto, auto get) {
+                if (!found && numbers[i++] == number) {
+                    found = true;
+                    ProtobufField<Field<decltype(get)>>::read(in, wire, get(x));
+                }
+            }));
+            if (!found) { protobuf::skip(in, wire); }
+        });
+    }
+
+    static void merge(binary::Input& in, T& x) {
+        binary::Input body(in.bytes(in.size()));
+        mergeBody(body, x);
+    }
+
+    static T read(binary::Input& in) {
+        T ret;
+        clear(ret);
+        merge(in, ret);
+        return ret;
+    }
+
+    static bool zero(T const&) { return false; }
+};
+
+
+struct ToProtobufT {
+    template <typename T>
+    std::string operator()(T const& x) const {
+        static_assert(boost::hana::Struct<T>::value,
+                      "A protobuf message has to be a reflected struct");
+        std::string ret;
+        ProtobufImpl<T>::writeBody(ret, x);
+        return ret;
+    }
+};
+
+
+/// Encode the message `x`
+constexpr ToProtobufT toProtobuf;
+
+
+template <typename T>
+struct FromProtobufT {
+    static_assert(boost::hana::Struct<T>::value,
+                  "A protobuf message has to be a reflected struct");
+
+    /// \throw `ProtobufError`, `BinaryError` on malformed input
+    T operator()(std::string_view data) const {
+        binary::Input in(data);
+        T ret;
+        ProtobufImpl<T>::clear(ret);
+        ProtobufImpl<T>::mergeBody(in, ret);
+        return ret;
+    }
+};
+
+
+/// Decode a message `T`
+template <typename T>
+constexpr FromProtobufT<T> fromProtobuf;
+
+
+}
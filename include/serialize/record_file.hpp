@@ -0,0 +1,214 @@
+/*
+  MIT License
+
+  Copyright (c) 2018 Nicolai Trandafil
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#pragma once
+
+
+// std
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+
+/// \file record_file.hpp
+/// Framed container of opaque records grouped into compressed blocks
+///
+/// Layout:
+///     header  "SREC" version
+///     blocks  codec, record count, raw size, stored size, payload
+///     index   per block: file offset, first record number, record count
+///     trailer index offset, block count, "SRIX"
+///
+/// A block payload is the concatenation of varint length-prefixed records.
+/// Integers are little endian.
+
+
+namespace serialize {
+
+
+/// Record file format or I/O error
+class RecordFileError : public std::runtime_error {
+public:
+    explicit RecordFileError(std::string const& x)
+        : runtime_error("Record file: " + x) {}
+};
+
+
+/// Block compression
+enum class Codec : std::uint8_t {
+    none = 0,
+    lz4 = 1,
+    zstd = 2
+};
+
+
+/// Whether the codec was compiled in
+bool codecSupported(Codec codec) noexcept;
+
+
+struct RecordWriterOptions {
+    Codec codec{Codec::none};
+
+    /// Uncompressed size which triggers a block flush
+    std::size_t block_size{1 << 20};
+
+    /// zstd compression level or LZ4 acceleration, 0 is the codec default
+    int level{0};
+};
+
+
+///
+/// Appends records to a new file
+///
+class RecordWriter {
+public:
+    /// \throw `RecordFileError`
+    explicit RecordWriter(std::string const& path,
+                          RecordWriterOptions const& options = {});
+
+    /// Closes the file, errors are swallowed, call `close` to observe them
+    ~RecordWriter();
+
+    RecordWriter(RecordWriter const&) = delete;
+    RecordWriter& operator=(RecordWriter const&) = delete;
+
+    void append(std::string_view record);
+
+    /// Compress and write out the pending records as a block
+    void flush();
+
+    /// Flush and write the block index
+    void close();
+
+private:
+    struct Entry {
+        std::uint64_t offset;
+        std::uint64_t first;
+        std::uint32_t count;
+    };
+
+    void write(std::string_view x);
+
+    int fd{-1};
+    RecordWriterOptions options;
+    std::uint64_t offset{0};
+    std::uint64_t records{0};
+    std::uint32_t pending{0};
+    std::string block;
+    std::string compressed;
+    std::vector<Entry> index;
+};
+
+
+///
+/// Decompressed block
+///
+class RecordBlock {
+public:
+    /// Number of the first record in the file
+    std::uint64_t first() const noexcept { return first_; }
+
+    std::size_t size() const noexcept { return spans.size(); }
+
+    std::string_view operator[](std::size_t i) const noexcept {
+        return std::string_view(data.data() + spans[i].first, spans[i].second);
+    }
+
+private:
+    friend class RecordReader;
+
+    std::uint64_t first_{0};
+    std::string data;
+    std::vector<std::pair<std::size_t, std::size_t>> spans;
+};
+
+
+///
+/// Random access reader, blocks may be read and decompressed concurrently
+///
+class RecordReader {
+public:
+    /// Opens the file and loads the block index
+    /// \throw `RecordFileError`
+    explicit RecordReader(std::string const& path);
+    ~RecordReader();
+
+    RecordReader(RecordReader const&) = delete;
+    RecordReader& operator=(RecordReader const&) = delete;
+
+    std::size_t blockCount() const noexcept { return index.size(); }
+    std::uint64_t recordCount() const noexcept { return records; }
+
+    /// Index of the block holding the record number `record`
+    /// \throw `std::out_of_range`
+    std::size_t blockOf(std::uint64_t record) const;
+
+    /// Read and decompress the block `i`, thread safe
+    /// \throw `RecordFileError`
+    RecordBlock block(std::size_t i) const;
+
+    /// Read and decompress the blocks [first, last) with up to `threads`
+    /// threads, 0 means hardware concurrency
+    std::vector<RecordBlock> blocks(std::size_t first,
+                                    std::size_t last,
+                                    unsigned threads = 0) const;
+
+    /// Call `f(std::string_view)` for every record in order, decompressing
+    /// up to `threads` blocks ahead in parallel
+    template <typename F>
+    void forEach(F&& f, unsigned threads = 0) const {
+        if (threads == 0) { threads = std::max(1u, std::thread::hardware_concurrency()); }
+        for (std::size_t i = 0; i < blockCount(); i += threads) {
+            auto const last = std::min<std::size_t>(blockCount(), i + threads);
+            for (auto const& b: blocks(i, last, threads)) {
+                for (std::size_t j = 0; j < b.size(); ++j) { f(b[j]); }
+            }
+        }
+    }
+
+private:
+    struct Entry {
+        std::uint64_t offset;
+        std::uint64_t first;
+        std::uint32_t count;
+    };
+
+    std::string read(std::uint64_t offset, std::size_t size) const;
+
+    int fd{-1};
+    std::uint64_t records{0};
+    std::vector<Entry> index;
+
+    /// Offset of the index, where the last block ends
+    std::uint64_t blocks_end{0};
+};
+
+
+}
@@ -0,0 +1,273 @@
+/*
+  MIT License
+
+  Copyright (c) 2018 Nicolai Trandafil
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#pragma once
+
+
+// local
+#include <serialize/variant.hpp>
+#include <serialize/variant_conversion.hpp>
+
+// std
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+
+/// \file snapshot.hpp
+/// Immutable values shared across threads and replaced as a whole
+///
+/// Readers pin the current snapshot without a lock or a shared reference
+/// count: they announce the global epoch in a slot of their own thread.
+/// Writers swap the pointer and retire the previous snapshot, which is
+/// freed once no slot holds an epoch older than its retirement.
+
+
+namespace serialize {
+
+
+class SnapshotError : public std::runtime_error {
+public:
+    explicit SnapshotError(std::string const& x)
+        : runtime_error("Snapshot: " + x) {}
+};
+
+
+namespace detail {
+
+
+/// Epoch based reclamation shared by all the snapshots of the process
+struct Epoch {
+    /// Announce the current epoch in the slot of the thread, nests
+    static void pin();
+    static void unpin() noexcept;
+
+    /// Start a new epoch
+    /// \return the new epoch
+    static std::uint64_t advance() noexcept;
+
+    /// Whether no thread is pinned since before `epoch`
+    static bool quiescent(std::uint64_t epoch) noexcept;
+};
+
+
+///
+/// Calls `changed` on a thread of its own after `path` is written or
+/// replaced by a rename
+///
+class FileWatcher {
+public:
+    /// \throw `SnapshotError` if `path` can not be watched
+    FileWatcher(std::string const& path, std::function<void()> changed);
+    ~FileWatcher();
+
+    FileWatcher(FileWatcher const&) = delete;
+    FileWatcher& operator=(FileWatcher const&) = delete;
+
+private:
+    void run(std::string const& name);
+
+    int fd{-1};
+    int stop[2]{-1, -1};
+    std::function<void()> changed;
+    std::thread thread;
+};
+
+
+/// Read the whole file at `path`
+/// \throw `SnapshotError`
+std::string readFile(std::string const& path);
+
+
+} // namespace detail
+
+
+struct SnapshotOptions {
+    /// Reload when the file changes
+    bool watch{true};
+
+    /// Called on the watcher thread when a reload fails, the current
+    /// snapshot is then kept
+    std::function<void(std::exception_ptr)> on_error;
+};
+
+
+///
+/// Process wide `T`, read lock free by many threads and replaced by `publish`
+/// or, when loaded from a JSON file, by the changes of the file
+///
+/// The instance must outlive its readers. `Variant` snapshots are frozen,
+/// their hashes are then computed once.
+///
+template <typename T>
+class SharedSnapshot {
+public:
+    ///
+    /// The snapshot current when `read()` was called, kept alive until the
+    /// reader dies
+    ///
+    class Reader {
+    public:
+        ~Reader() { detail::Epoch::unpin(); }
+
+        Reader(Reader const&) = delete;
+        Reader& operator=(Reader const&) = delete;
+
+        T const& operator*() const noexcept { return *x; }
+        T const* operator->() const noexcept { return x; }
+
+    private:
+        friend class SharedSnapshot;
+
+        /// The pin comes first, the pointer loaded after it is then
+        /// retired no sooner than in the next epoch
+        explicit Reader(std::atomic<T const*> const& current)
+            : x((detail::Epoch::pin(), current.load(std::memory_order_seq_cst)))
+        {}
+
+        T const* x;
+    };
+
+    explicit SharedSnapshot(T x) : current(new T const(freeze(std::move(x)))) {}
+
+    ///
+    /// Load the JSON file `path` through `fromVariant<T>`
+    ///
+    /// \throw `SnapshotError` if the file can not be read or watched, the
+    /// errors of `Variant::fromJson` and `fromVariant<T>`
+    ///
+    explicit SharedSnapshot(std::string path, SnapshotOptions options = {})
+        : path(std::move(path))
+        , options(std::move(options))
+        , current(new T const(freeze(load())))
+    {
+        if (this->options.watch) {
+            watcher = std::make_unique<detail::FileWatcher>(
+                this->path, [this] { reloadOrReport(); });
+        }
+    }
+
+    ~SharedSnapshot() {
+        watcher.reset();
+        delete current.load();
+        for (auto const& x: retired) { delete x.second; }
+    }
+
+    SharedSnapshot(SharedSnapshot const&) = delete;
+    SharedSnapshot& operator=(SharedSnapshot const&) = delete;
+
+    Reader read() const { return Reader(current); }
+
+    /// Replace the snapshot, the previous one is freed when its readers
+    /// are gone, on a later `publish` or `reclaim`
+    void publish(T x) {
+        auto next = std::make_unique<T const>(freeze(std::move(x)));
+        std::lock_guard<std::mutex> lock(writer);
+        retired.reserve(retired.size() + 1);
+        auto const old = current.exchange(next.release(),
+                                          std::memory_order_seq_cst);
+        retired.emplace_back(detail::Epoch::advance(), old);
+        version_.fetch_add(1, std::memory_order_release);
+        collect();
+    }
+
+    /// Load and publish the file again
+    /// \throw as the constructor, the current snapshot is then kept
+    void reload() { publish(load()); }
+
+    /// Free the retired snapshots no reader holds anymore
+    void reclaim() {
+        std::lock_guard<std::mutex> lock(writer);
+        collect();
+    }
+
+    /// Number of snapshots published, the first one included
+    std::uint64_t version() const noexcept {
+        return version_.load(std::memory_order_acquire);
+    }
+
+private:
+    static T freeze(T x) {
+        if constexpr (std::is_same_v<T, Variant>) { x.freeze(); }
+        return x;
+    }
+
+    T load() const {
+        auto var = Variant::fromJson(detail::readFile(path));
+        if constexpr (std::is_same_v<T, Variant>) {
+            return var;
+        } else {
+            return fromVariant<T>(var);
+        }
+    }
+
+    void reloadOrReport() noexcept {
+        try {
+            reload();
+        } catch (...) {
+            if (options.on_error) { options.on_error(std::current_exception()); }
+        }
+    }
+
+    void collect() {
+        retired.erase(std::remove_if(retired.begin(), retired.end(),
+                                     [](auto const& x) {
+                                         if (!detail::Epoch::quiescent(x.first)) {
+                                             return false;
+                                         }
+                                         delete x.second;
+                                         return true;
+                                     }),
+                      retired.end());
+    }
+
+    std::string const path;
+    SnapshotOptions const options;
+
+    std::atomic<T const*> current;
+    std::atomic<std::uint64_t> version_{1};
+
+    /// Guards the writes
+    std::mutex writer;
+
+    /// Replaced snapshots with the epoch they were retired in
+    std::vector<std::pair<std::uint64_t, T const*>> retired;
+
+    /// Last, to stop before the rest is destroyed
+    std::unique_ptr<detail::FileWatcher> watcher;
+};
+
+
+}
@@ -0,0 +1,563 @@
+/*
+  MIT License
+
+  Copyright (c) 2018 Nicolai Trandafil
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#pragma once
+
+
+// local
+#include <serialize/algorithm/hash.hpp>
+
+// std
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+
+/// \file string_map.hpp
+/// Hash map keyed by strings with lookup by a precomputed hash
+
+
+namespace serialize {
+
+
+///
+/// Key for `StringMap` lookup, a string view with its FNV-1a hash
+///
+/// The hash may be computed at compile time, see `FieldNames`.
+///
+struct PrehashedKey {
+    constexpr PrehashedKey(std::string_view name, std::uint64_t hash) noexcept
+        : name(name), hash(hash) {}
+
+    constexpr PrehashedKey(std::string_view name) noexcept
+        : PrehashedKey(name, fnv1a(name)) {}
+
+    constexpr PrehashedKey(char const* name) noexcept
+        : PrehashedKey(std::string_view(name)) {}
+
+    PrehashedKey(std::string const& name) noexcept
+        : PrehashedKey(std::string_view(name)) {}
+
+    std::string_view name;
+    std::uint64_t hash;
+};
+
+
+///
+/// Hash map from `std::string` to `T`
+///
+/// Entries are kept in a dense vector, small maps are searched linearly and
+/// larger ones through an open addressing index. Lookups take any string like
+/// key and never allocate. Iteration follows the insertion order. Erasure
+/// leaves a tombstone, which insertion and erasure by key compact once they
+/// are the majority, so erasing is constant time. Iterators yield pairs of
+/// references with a read only key. Insertion and erasure by key invalidate
+/// iterators and references, erasure by iterator only the erased ones.
+///
+template <typename T>
+class StringMap {
+    struct Entry;
+
+    template <bool Const>
+    class Iterator;
+
+public:
+    using key_type = std::string;
+    using mapped_type = T;
+    using value_type = std::pair<std::string, T>;
+    using size_type = std::size_t;
+    using difference_type = std::ptrdiff_t;
+    using reference = std::pair<std::string const&, T&>;
+    using const_reference = std::pair<std::string const&, T const&>;
+    using iterator = Iterator<false>;
+    using const_iterator = Iterator<true>;
+
+private:
+    /// Enabled for `std::string` rvalues
+    template <typename K>
+    using IfString = std::enable_if_t<std::is_same_v<K, std::string>>;
+
+public:
+
+    StringMap() = default;
+
+    StringMap(std::initializer_list<value_type> xs)
+        : StringMap(xs.begin(), xs.end()) {}
+
+    template <typename It>
+    StringMap(It first, It last) {
+        for (; first != last; ++first) { emplace(first->first, first->second); }
+    }
+
+    /// Copies the live entries only, without the tombstones
+    StringMap(StringMap const& rhs) {
+        reserve(rhs.size());
+        for (auto it = rhs.begin(); it != rhs.end(); ++it) {
+            append(rhs.key(it).hash, it->first, it->second);
+        }
+    }
+
+    StringMap& operator=(StringMap const& rhs) {
+        if (this != &rhs) { *this = StringMap(rhs); }
+        return *this;
+    }
+
+    StringMap(StringMap&&) noexcept = default;
+    StringMap& operator=(StringMap&&) noexcept = default;
+
+    size_type size() const noexcept { return entries.size() - dead; }
+    bool empty() const noexcept { return size() == 0; }
+
+    iterator begin() noexcept { return at(0); }
+    iterator end() noexcept { return at(entries.size()); }
+    const_iterator begin() const noexcept { return at(0); }
+    const_iterator end() const noexcept { return at(entries.size()); }
+    const_iterator cbegin() const noexcept { return begin(); }
+    const_iterator cend() const noexcept { return end(); }
+
+    void reserve(size_type n) {
+        entries.reserve(n);
+        hashes.reserve(n);
+        if (n > linear_limit && n * 4 > slots.size() * 3) {
+            rehash(slotsFor(n));
+        }
+    }
+
+    /// Bytes of the buffers of the map, without the keys and values
+    size_type allocatedBytes() const noexcept {
+        return entries.capacity() * sizeof(Entry) +
+               hashes.capacity() * sizeof(std::uint64_t) +
+               slots.capacity() * sizeof(Slot);
+    }
+
+    /// Heap blocks of the buffers of the map
+    size_type allocatedBlocks() const noexcept {
+        return size_type(entries.capacity() != 0) +
+               size_type(hashes.capacity() != 0) +
+               size_type(slots.capacity() != 0);
+    }
+
+    void clear() noexcept {
+        entries.clear();
+        hashes.clear();
+        slots.clear();
+        dead = 0;
+    }
+
+    iterator find(PrehashedKey key) noexcept {
+        auto const i = lookup(key);
+        return i == npos ? end() : at(i);
+    }
+
+    const_iterator find(PrehashedKey key) const noexcept {
+        auto const i = lookup(key);
+        return i == npos ? end() : at(i);
+    }
+
+    /// Lookup key of the entry at `pos`, with its stored hash
+    PrehashedKey key(const_iterator pos) const noexcept {
+        auto const i = indexOf(pos);
+        return {entries[i].key, hashes[i]};
+    }
+
+    size_type count(PrehashedKey key) const noexcept {
+        return lookup(key) == npos ? 0 : 1;
+    }
+
+    bool contains(PrehashedKey key) const noexcept {
+        return lookup(key) != npos;
+    }
+
+    /// \throw `std::out_of_range`
+    T& at(PrehashedKey key) {
+        auto const i = lookup(key);
+        if (i == npos) { throw std::out_of_range("StringMap::at"); }
+        return entries[i].value;
+    }
+
+    /// \throw `std::out_of_range`
+    T const& at(PrehashedKey key) const {
+        auto const i = lookup(key);
+        if (i == npos) { throw std::out_of_range("StringMap::at"); }
+        return entries[i].value;
+    }
+
+    T& operator[](PrehashedKey key) { return try_emplace(key).first->second; }
+
+    /// Takes over the storage of a `std::string` rvalue key
+    template <typename K, typename = IfString<K>>
+    T& operator[](K&& key) {
+        return try_emplace(std::move(key)).first->second;
+    }
+
+    /// Insert `T(args...)` unless `key` is present
+    template <typename ...Args>
+    std::pair<iterator, bool> try_emplace(PrehashedKey key, Args&&... args) {
+        auto const i = lookup(key);
+        if (i != npos) { return {at(i), false}; }
+        return {append(key.hash, key.name, std::forward<Args>(args)...), true};
+    }
+
+    template <typename K, typename ...Args, typename = IfString<K>>
+    std::pair<iterator, bool> try_emplace(K&& key, Args&&... args) {
+        PrehashedKey const k(key);
+        auto const i = lookup(k);
+        if (i != npos) { return {at(i), false}; }
+        return {append(k.hash, std::move(key), std::forward<Args>(args)...), true};
+    }
+
+    template <typename K, typename ...Args, typename = std::enable_if_t<
+                  std::is_constructible_v<PrehashedKey, K const&>>>
+    std::pair<iterator, bool> emplace(K&& key, Args&&... args) {
+        if constexpr (std::is_same_v<std::decay_t<K>, std::string> &&
+                      !std::is_lvalue_reference_v<K>) {
+            return try_emplace(std::move(key), std::forward<Args>(args)...);
+        } else {
+            return try_emplace(PrehashedKey(key), std::forward<Args>(args)...);
+        }
+    }
+
+    std::pair<iterator, bool> insert(value_type const& x) {
+        return try_emplace(PrehashedKey(x.first), x.second);
+    }
+
+    std::pair<iterator, bool> insert(value_type&& x) {
+        return try_emplace(std::move(x.first), std::move(x.second));
+    }
+
+    template <typename M>
+    std::pair<iterator, bool> insert_or_assign(PrehashedKey key, M&& x) {
+        auto ret = try_emplace(key, std::forward<M>(x));
+        if (!ret.second) { ret.first->second = std::forward<M>(x); }
+        return ret;
+    }
+
+    size_type erase(PrehashedKey key) {
+        auto const i = lookup(key);
+        if (i == npos) { return 0; }
+        eraseAt(i);
+        if (crowded()) { compact(); }
+        return 1;
+    }
+
+    /// Keeps the other iterators valid, the tombstone stays until the next
+    /// insertion or erasure by key
+    /// \return iterator to the entry following `pos`
+    iterator erase(const_iterator pos) {
+        auto const i = indexOf(pos);
+        eraseAt(i);
+        return at(i);
+    }
+
+    void swap(StringMap& rhs) noexcept {
+        entries.swap(rhs.entries);
+        hashes.swap(rhs.hashes);
+        slots.swap(rhs.slots);
+        std::swap(dead, rhs.dead);
+    }
+
+    /// Same keys mapped to equal values, regardless of the order
+    friend bool operator==(StringMap const& lhs, StringMap const& rhs) {
+        if (lhs.size() != rhs.size()) { return false; }
+        for (size_type i = 0; i < lhs.entries.size(); ++i) {
+            auto const& x = lhs.entries[i];
+            if (!x.live) { continue; }
+            auto const j = rhs.lookup({x.key, lhs.hashes[i]});
+            if (j == npos || !(rhs.entries[j].value == x.value)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    friend bool operator!=(StringMap const& lhs, StringMap const& rhs) {
+        return !(lhs == rhs);
+    }
+
+private:
+    /// Erased entries are tombstones, not live and holding moved from values
+    struct Entry {
+        template <typename K, typename ...Args>
+        Entry(std::piecewise_construct_t, K&& key, Args&&... args)
+            : key(std::forward<K>(key))
+            , value(std::forward<Args>(args)...)
+        {}
+
+        std::string key;
+        T value;
+        bool live = true;
+    };
+
+    /// Bidirectional iterator skipping the tombstones
+    template <bool Const>
+    class Iterator {
+        using Stored = std::conditional_t<Const, Entry const, Entry>;
+
+    public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type = StringMap::value_type;
+        using difference_type = std::ptrdiff_t;
+        using reference = std::conditional_t<Const, const_reference,
+                                             StringMap::reference>;
+
+        /// Holds the pair of references `->` points to
+        struct pointer {
+            reference* operator->() noexcept { return &x; }
+            reference x;
+        };
+
+        Iterator() = default;
+
+        template <bool C = Const, typename = std::enable_if_t<C>>
+        Iterator(Iterator<false> const& rhs) noexcept
+            : pos(rhs.pos), last(rhs.last) {}
+
+        reference operator*() const noexcept { return {pos->key, pos->value}; }
+        pointer operator->() const noexcept { return {**this}; }
+
+        Iterator& operator++() noexcept {
+            ++pos;
+            skip();
+            return *this;
+        }
+
+        Iterator operator++(int) noexcept {
+            auto ret = *this;
+            ++*this;
+            return ret;
+        }
+
+        Iterator& operator--() noexcept {
+            do { --pos; } while (!pos->live);
+            return *this;
+        }
+
+        Iterator operator--(int) noexcept {
+            auto ret = *this;
+            --*this;
+            return ret;
+        }
+
+        friend bool operator==(Iterator const& lhs, Iterator const& rhs) noexcept {
+            return lhs.pos == rhs.pos;
+        }
+
+        friend bool operator!=(Iterator const& lhs, Iterator const& rhs) noexcept {
+            return lhs.pos != rhs.pos;
+        }
+
+    private:
+        friend class StringMap;
+        friend class Iterator<!Const>;
+
+        Iterator(Stored* pos, Stored* last) noexcept : pos(pos), last(last) {
+            skip();
+        }
+
+        void skip() noexcept {
+            while (pos != last && !pos->live) { ++pos; }
+        }
+
+        Stored* pos = nullptr;
+        Stored* last = nullptr;
+    };
+
+    /// Index slot, `entry` is the entry position plus one, 0 when free
+    struct Slot {
+        std::uint32_t entry;
+        std::uint32_t tag;
+    };
+
+    static constexpr size_type npos = size_type(-1);
+
+    /// Maps up to this size have no index
+    static constexpr size_type linear_limit = 8;
+
+    static constexpr std::uint32_t tag(std::uint64_t hash) noexcept {
+        return static_cast<std::uint32_t>(hash);
+    }
+
+    size_type home(std::uint64_t hash) const noexcept {
+        return size_type(hash ^ (hash >> 32)) & (slots.size() - 1);
+    }
+
+    static size_type slotsFor(size_type n) noexcept {
+        size_type ret = 16;
+        while (ret * 3 < n * 4) { ret *= 2; }
+        return ret;
+    }
+
+    /// First live entry from position `i`
+    iterator at(size_type i) noexcept {
+        auto const data = entries.data();
+        return {data + i, data + entries.size()};
+    }
+
+    const_iterator at(size_type i) const noexcept {
+        auto const data = entries.data();
+        return {data + i, data + entries.size()};
+    }
+
+    size_type indexOf(const_iterator pos) const noexcept {
+        return size_type(pos.pos - entries.data());
+    }
+
+    size_type lookup(PrehashedKey key) const noexcept {
+        if (slots.empty()) {
+            for (size_type i = 0; i < entries.size(); ++i) {
+                auto const& x = entries[i];
+                if (hashes[i] == key.hash && x.live && x.key == key.name) {
+                    return i;
+                }
+            }
+            return npos;
+        }
+
+        auto const mask = slots.size() - 1;
+        for (auto i = home(key.hash);; i = (i + 1) & mask) {
+            auto const& slot = slots[i];
+            if (slot.entry == 0) { return npos; }
+            if (slot.tag == tag(key.hash) &&
+                    entries[slot.entry - 1].key == key.name) {
+                return slot.entry - 1;
+            }
+        }
+    }
+
+    template <typename K, typename ...Args>
+    iterator append(std::uint64_t hash, K&& key, Args&&... args) {
+        if (crowded()) { compact(); }
+        hashes.push_back(hash);
+        try {
+            entries.emplace_back(std::piecewise_construct,
+                                 std::forward<K>(key),
+                                 std::forward<Args>(args)...);
+        } catch (...) {
+            hashes.pop_back();
+            throw;
+        }
+
+        auto const n = entries.size();
+        if (n > linear_limit && n * 4 > slots.size() * 3) {
+            try {
+                rehash(slotsFor(n));
+            } catch (...) {
+                entries.pop_back();
+                hashes.pop_back();
+                throw;
+            }
+        } else if (!slots.empty()) {
+            place(n - 1);
+        }
+        return at(n - 1);
+    }
+
+    void place(size_type entry) noexcept {
+        auto const mask = slots.size() - 1;
+        auto i = home(hashes[entry]);
+        while (slots[i].entry != 0) { i = (i + 1) & mask; }
+        slots[i] = Slot{static_cast<std::uint32_t>(entry + 1), tag(hashes[entry])};
+    }
+
+    void rehash(size_type n) {
+        slots.assign(n, Slot{0, 0});
+        for (size_type i = 0; i < entries.size(); ++i) {
+            if (entries[i].live) { place(i); }
+        }
+    }
+
+    size_type slotOf(size_type entry) const noexcept {
+        auto const mask = slots.size() - 1;
+        auto i = home(hashes[entry]);
+        while (slots[i].entry != entry + 1) { i = (i + 1) & mask; }
+        return i;
+    }
+
+    /// Backward shift deletion of the slot of `entry`
+    void unplace(size_type entry) noexcept {
+        auto const mask = slots.size() - 1;
+        auto i = slotOf(entry);
+        for (auto j = (i + 1) & mask; slots[j].entry != 0; j = (j + 1) & mask) {
+            auto const k = home(hashes[slots[j].entry - 1]);
+            bool const stays = i < j ? (i < k && k <= j) : (i < k || k <= j);
+            if (!stays) {
+                slots[i] = slots[j];
+                i = j;
+            }
+        }
+        slots[i] = Slot{0, 0};
+    }
+
+    /// Releases the key and value of the entry, which becomes a tombstone
+    void eraseAt(size_type i) {
+        if (!slots.empty()) { unplace(i); }
+        auto& x = entries[i];
+        x.live = false;
+        std::string().swap(x.key);
+        [[maybe_unused]] T const released(std::move(x.value));
+        ++dead;
+    }
+
+    /// Are tombstones the majority
+    bool crowded() const noexcept { return dead * 2 > entries.size(); }
+
+    /// Drops the tombstones keeping the order of the live entries
+    void compact() {
+        size_type n = 0;
+        for (size_type i = 0; i < entries.size(); ++i) {
+            if (!entries[i].live) { continue; }
+            if (i != n) {
+                entries[n] = std::move(entries[i]);
+                hashes[n] = hashes[i];
+            }
+            ++n;
+        }
+        entries.erase(entries.begin() + difference_type(n), entries.end());
+        hashes.resize(n);
+        dead = 0;
+
+        if (n <= linear_limit) {
+            slots.clear();
+        } else {
+            rehash(slots.size());
+        }
+    }
+
+    std::vector<Entry> entries;
+    std::vector<std::uint64_t> hashes;
+    std::vector<Slot> slots;
+
+    /// Number of tombstones in `entries`
+    size_type dead = 0;
+};
+
+
+}
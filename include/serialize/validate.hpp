@@ -0,0 +1,531 @@
+/*
+  MIT License
+
+  Copyright (c) 2018 Nicolai Trandafil
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+#pragma once
+
+
+// local
+#include <serialize/field_names.hpp>
+#include <serialize/meta.hpp>
+#include <serialize/variant.hpp>
+#include <serialize/variant_conversion.hpp>
+#include <serialize/variant_traits.hpp>
+#include <serialize/when.hpp>
+
+// boost
+#include <boost/hana.hpp>
+
+// std
+#include <cstddef>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+
+/// \file validate.hpp
+/// Checks that a `Variant` converts to a type, and conversions reporting
+/// the mismatches instead of throwing
+///
+/// The checks follow the conversions of `variant_conversion.hpp` and
+/// `variant_traits.hpp`: the kinds of values, the integral ranges, the
+/// members required by reflected structs and hana maps, the values of hana
+/// constants and the tags of tagged unions. Types converted by user code,
+/// including reflected structs with a `fromVariant` of their own, are
+/// accepted as is.
+
+
+namespace serialize {
+
+
+/// Why a value does not convert
+enum class ValidationErrc {
+    missing,        ///< a required member is absent
+    empty,          ///< a value is required
+    bad_type,       ///< the value is of another kind
+    overflow,       ///< the integral value is out of the type range
+    unknown_tag,    ///< the discriminator names no alternative
+    parse           ///< the serialized input is malformed
+};
+
+
+/// Description of `x`
+char const* describe(ValidationErrc x) noexcept;
+
+
+namespace validation {
+
+
+///
+/// Path to the value under check, one node per level of the recursion
+///
+/// Nodes live on the stack and are only copied on error
+///
+struct Path {
+    Path const* parent{nullptr};
+    std::string_view key;
+    std::size_t index{0};
+    bool is_index{false};
+};
+
+
+/// A step of a path kept by an error, a key or an index
+struct Segment {
+    std::string key;
+    std::size_t index{0};
+    bool is_index{false};
+
+    bool operator==(Segment const& rhs) const noexcept {
+        return key == rhs.key && index == rhs.index && is_index == rhs.is_index;
+    }
+};
+
+
+} // namespace validation
+
+
+///
+/// A value, which does not convert, and where it is
+///
+/// The path is kept as segments, it is formatted only when asked for
+///
+struct ValidationError {
+    ValidationErrc code;
+    std::vector<validation::Segment> segments;
+
+    /// Dotted path to the value, like `points[2].x`, empty for the root
+    std::string path() const;
+
+    /// The path and the description of the code
+    std::string message() const;
+
+    bool operator==(ValidationError const& rhs) const noexcept {
+        return code == rhs.code && segments == rhs.segments;
+    }
+};
+
+
+using ValidationErrors = std::vector<ValidationError>;
+
+
+namespace validation {
+
+
+/// Segments of `path`, from the root
+std::vector<Segment> capture(Path const* path);
+
+
+/// Errors found so far, the checks stop once there are `limit` of them
+struct Report {
+    ValidationErrors errors;
+    std::size_t limit{std::numeric_limits<std::size_t>::max()};
+
+    bool full() const noexcept { return errors.size() >= limit; }
+
+    void fail(Path const* path, ValidationErrc code) {
+        errors.push_back({code, capture(path)});
+    }
+};
+
+
+/// Error for a value, which is not a `T`
+template <typename T>
+ValidationErrc mismatch(Variant const& var) noexcept {
+    if (var.empty()) { return ValidationErrc::empty; }
+    if constexpr (std::is_integral_v<T>) {
+        if (var.is<signed long>() || var.is<unsigned long>()) {
+            return ValidationErrc::overflow;
+        }
+    }
+    return ValidationErrc::bad_type;
+}
+
+
+template <typename T, typename Policy>
+std::true_type isVarDef(trait::VarDef<T, Policy> const*);
+
+template <typename T>
+std::false_type isVarDef(void const*);
+
+
+/// Whether `T::fromVariant` is the one of the reflection traits, which
+/// the checks of the reflected structs follow
+template <typename T>
+constexpr bool reflectedConversion() {
+    if constexpr (std::is_base_of_v<trait::Var<T>, T> ||
+                  std::is_base_of_v<trait::VarDefExplicit<T>, T>) {
+        return true;
+    } else {
+        return decltype(isVarDef<T>(std::declval<T const*>()))::value;
+    }
+}
+
+
+} // namespace validation
+
+
+/// Checks of `Variant` against T
+template <typename T, typename = void>
+struct ValidateImpl : ValidateImpl<T, When<true>> {};
+
+
+/// Fallback, converted by user code
+template <typename T, bool condition>
+struct ValidateImpl<T, When<condition>> {
+    static void apply(Variant const&, validation::Path const*, validation::Report&) {}
+};
+
+
+/// Specialization for types for which Variant have conversion
+template <typename T>
+struct ValidateImpl<T, When<Variant::Types::anyOf<T>()>> {
+    static void apply(Variant const& var, validation::Path const* path,
+                      validation::Report& report) {
+        if (!var.is<T>()) {
+            report.fail(path, validation::mismatch<T>(var));
+        }
+    }
+};
+
+
+/// Specialization for optional types
+template <typename T>
+struct ValidateImpl<T, When<isOptional(type_c<T>)>> {
+    static void apply(Variant const& var, validation::Path const* path,
+                      validation::Report& report) {
+        if (!var.empty()) {
+            ValidateImpl<typename T::value_type>::apply(var, path, report);
+        }
+    }
+};
+
+
+/// Specialization for collection types
+template <typename T>
+struct ValidateImpl<T, When<
+        !Variant::Types::anyOf<T>() &&
+        !boost::hana::Struct<T>::value &&
+        isContainer(type_c<T>) &&
+        !isKeyValue(type_c<typename T::value_type>) &&
+        (hasPushBack(boost::hana::type_c<T>) ||
+         hasEmplace(boost::hana::type_c<T>))>> {
+    static void apply(Variant const& var, validation::Path const* path,
+                      validation::Report& report) {
+        if (!var.is<Variant::Vec>()) {
+            report.fail(path, validation::mismatch<Variant::Vec>(var));
+            return;
+        }
+
+        auto const& vec = var.vec();
+        for (std::size_t i = 0; i < vec.size() && !report.full(); ++i) {
+            validation::Path const node{path, {}, i, true};
+            ValidateImpl<typename T::value_type>::apply(vec[i], &node, report);
+        }
+    }
+};
+
+
+/// Specialization for map types
+template <typename T>
+struct ValidateImpl<T, When<
+        !Variant::Types::anyOf<T>() &&
+        !boost::hana::Struct<T>::value &&
+        isContainer(type_c<T>) &&
+        isKeyValue(type_c<typename T::value_type>)>> {
+    static void apply(Variant const& var, validation::Path const* path,
+                      validation::Report& report) {
+        if (!var.is<Variant::Map>()) {
+            report.fail(path, validation::mismatch<Variant::Map>(var));
+            return;
+        }
+
+        for (auto const& x: var.map()) {
+            if (report.full()) { return; }
+            validation::Path const node{path, x.first};
+            ValidateImpl<typename T::mapped_type>::apply(x.second, &node, report);
+        }
+    }
+};
+
+
+/// Specialization for hana maps, every key is required
+template <typename T>
+struct ValidateImpl<T, When<hanaMap(type_c<T>)>> {
+    static void apply(Variant const& var, validation::Path const* path,
+                      validation::Report& report) {
+        if (!var.is<Variant::Map>()) {
+            report.fail(path, validation::mismatch<Variant::Map>(var));
+            return;
+        }
+
+        auto const& map = var.map();
+        boost::hana::for_each(boost::hana::keys(T()), [&](auto key) {
+            using F = std::decay_t<decltype(std::declval<T&>()[key])>;
+            if (report.full()) { return; }
+            char const* name = boost::hana::to<char const*>(key);
+            validation::Path const node{path, name};
+            auto const it = map.find(name);
+            if (it == map.end()) {
+                report.fail(&node, ValidationErrc::missing);
+            } else {
+                ValidateImpl<F>::apply(it->second, &node, report);
+            }
+        });
+    }
+};
+
+
+/// Specialization for hana constants, the value must be the constant one
+template <typename T>
+struct ValidateImpl<T, When<boost::hana::Constant<T>().value>> {
+    using U = typename T::value_type;
+
+    static void apply(Variant const& var, validation::Path const* path,
+                      validation::Report& report) {
+        auto const size = report.errors.size();
+        ValidateImpl<U>::apply(var, path, report);
+        if (report.errors.size() == size && fromVariant<U>(var) != T::value) {
+            report.fail(path, ValidationErrc::bad_type);
+        }
+    }
+};
+
+
+#if SERIALIZE_ENABLE_TYPE_SAFE
+/// Specialization for `type_safe::strong_typedef`
+template <typename T>
+struct ValidateImpl<T, When<
+        !hasFromVariant(type_c<T>) && strongTypeDef(type_c<T>)>>
+    : ValidateImpl<type_safe::underlying_type<T>> {};
+
+
+/// Specialization for `type_safe::constrained_type`, the constraint is
+/// checked by the conversion
+template <typename T>
+struct ValidateImpl<T, When<constrainedType(type_c<T>)>>
+    : ValidateImpl<std::decay_t<typename T::value_type>> {};
+
+
+/// Specialization for `type_safe::integer`
+template <typename T>
+struct ValidateImpl<T, When<integerType(type_c<T>)>>
+    : ValidateImpl<typename T::integer_type> {};
+
+
+/// Specialization for `type_safe::floating_point`
+template <typename T>
+struct ValidateImpl<T, When<floatingPoint(type_c<T>)>>
+    : ValidateImpl<typename T::floating_point_type> {};
+
+
+/// Specialization for `type_safe::boolean`
+template <typename T>
+struct ValidateImpl<T, When<boolean(type_c<T>)>> : ValidateImpl<bool> {};
+#endif
+
+
+/// Specialization for reflected structs converted by the reflection traits
+///
+/// A member may be absent when it has a default value or, for structs with
+/// `defaults()`, when it is optional
+template <typename T>
+struct ValidateImpl<T, When<
+        boost::hana::Struct<T>::value &&
+        validation::reflectedConversion<T>()>> {
+    template <typename F, typename Name>
+    static constexpr bool required(Name name) {
+        if constexpr (trait::detail::hasDefaults(boost::hana::type_c<T>)) {
+            return !isOptional(type_c<F>) &&
+                   !trait::detail::hasDefaultValue<T>(name);
+        } else {
+            return true;
+        }
+    }
+
+    static void apply(Variant const& var, validation::Path const* path,
+                      validation::Report& report) {
+        if (!var.is<Variant::Map>()) {
+            report.fail(path, validation::mismatch<Variant::Map>(var));
+            return;
+        }
+
+        auto const& map = var.map();
+        std::size_t i = 0;
+        boost::hana::for_each(boost::hana::accessors<T>(),
+                              boost::hana::fuse([&](auto name, auto get) {
+            using F = std::decay_t<decltype(get(std::declval<T&>()))>;
+            auto const key = FieldNames<T>::key(i++);
+            if (report.full()) { return; }
+            validation::Path const node{path, key.name};
+            auto const it = map.find(key);
+            if (it != map.end()) {
+                ValidateImpl<F>::apply(it->second, &node, report);
+            } else if constexpr (required<F>(name)) {
+                report.fail(&node, ValidationErrc::missing);
+            }
+        }));
+    }
+};
+
+
+/// Specialization for tagged unions
+template <typename T>
+struct ValidateImpl<T, When<taggedUnion(type_c<T>)>> {
+    using Tags = UnionTags<T>;
+
+    static void apply(Variant const& var, validation::Path const* path,
+                      validation::Report& report) {
+        if (!var.is<Variant::Map>()) {
+            report.fail(path, validation::mismatch<Variant::Map>(var));
+            return;
+        }
+
+        auto const& map = var.map();
+        validation::Path const node{path, Tags::discriminator.name};
+        auto const it = map.find(Tags::discriminator);
+        if (it == map.end()) {
+            report.fail(&node, ValidationErrc::missing);
+            return;
+        }
+
+        Variant const& tag = it->second;
+        if (!tag.is<std::string>()) {
+            report.fail(&node, validation::mismatch<std::string>(tag));
+        } else if (auto const i = Tags::find(tag.str()); i == Tags::size) {
+            report.fail(&node, ValidationErrc::unknown_tag);
+        } else {
+            alternative(i, var, path, report,
+                        std::make_index_sequence<Tags::size>());
+        }
+    }
+
+private:
+    template <std::size_t ...I>
+    static void alternative(std::size_t i, Variant const& var,
+                            validation::Path const* path,
+                            validation::Report& report, std::index_sequence<I...>) {
+        using Fn = void (*)(Variant const&, validation::Path const*,
+                            validation::Report&);
+        static constexpr Fn table[] = {
+            &ValidateImpl<std::variant_alternative_t<I, T>>::apply...
+        };
+        table[i](var, path, report);
+    }
+};
+
+
+///
+/// Errors converting `x` to `T`, empty when it converts
+///
+/// Checks the whole value in one pass and never throws for a mismatch
+///
+template <typename T>
+ValidationErrors validate(Variant const& x) {
+    validation::Report ret;
+    ValidateImpl<std::decay_t<T>>::apply(x, nullptr, ret);
+    return std::move(ret.errors);
+}
+
+
+///
+/// Thrown by `Result::value()` holding an error
+///
+class ConversionError final : public VariantErr {
+public:
+    explicit ConversionError(ValidationError x)
+        : VariantErr(x.message())
+        , error(std::move(x))
+    {}
+
+    ValidationError error;
+};
+
+
+///
+/// Either a converted `T` or the first error preventing the conversion
+///
+template <typename T>
+class Result {
+public:
+    Result(T x) : m(std::in_place_index<0>, std::move(x)) {}
+    Result(ValidationError x) : m(std::in_place_index<1>, std::move(x)) {}
+
+    bool has_value() const noexcept { return m.index() == 0; }
+    explicit operator bool() const noexcept { return has_value(); }
+
+    /// \throw `ConversionError` holding the error
+    T& value() & { check(); return std::get<0>(m); }
+    T const& value() const& { check(); return std::get<0>(m); }
+    T&& value() && { check(); return std::get<0>(std::move(m)); }
+
+    T& operator*() noexcept { return *std::get_if<0>(&m); }
+    T const& operator*() const noexcept { return *std::get_if<0>(&m); }
+    T* operator->() noexcept { return std::get_if<0>(&m); }
+    T const* operator->() const noexcept { return std::get_if<0>(&m); }
+
+    /// Requires `!has_value()`
+    ValidationError const& error() const noexcept { return *std::get_if<1>(&m); }
+
+private:
+    void check() const {
+        if (!has_value()) { throw ConversionError(error()); }
+    }
+
+    std::variant<T, ValidationError> m;
+};
+
+
+///
+/// Converts `x` to `T`, or reports why it does not convert
+///
+/// The value is checked by `ValidateImpl` up to the first error, then
+/// converted. Malformed input costs no exception, errors thrown by user
+/// conversions pass through
+///
+template <typename T>
+Result<T> tryFromVariant(Variant const& x) {
+    validation::Report report;
+    report.limit = 1;
+    ValidateImpl<T>::apply(x, nullptr, report);
+    if (!report.errors.empty()) { return std::move(report.errors.front()); }
+    return fromVariant<T>(x);
+}
+
+
+/// Parses `json` and converts it to `T`, see `tryFromVariant`
+template <typename T>
+Result<T> tryFromJson(std::string const& json) {
+    rapidjson::Document d;
+    if (d.Parse(json.c_str()).HasParseError()) {
+        return ValidationError{ValidationErrc::parse, {}};
+    }
+    return tryFromVariant<T>(Variant::from(d));
+}
+
+
+}
@@ -29,20 +29,34 @@
 // local
 #include <serialize/pimpl.hpp>
 #include <serialize/meta.hpp>
+#include <serialize/string_map.hpp>
 
 // 3rd
 #include <rapidjson/document.h>
 
+// boost
+#include <boost/container/small_vector.hpp>
+
 // std
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <string>
+#include <string_view>
 #include <type_traits>
 #include <vector>
-#include <unordered_map>
 
 
 namespace serialize {
 
 
+namespace cbor { class Writer; }
+
+
+class Path;
+
+
 ///
 /// An error identifying `Variant` error
 ///
@@ -70,6 +84,15 @@ public:
 };
 
 
+///
+/// Modification of a value inside a frozen one
+///
+class VariantFrozen final : public VariantErr {
+public:
+    explicit VariantFrozen() : VariantErr("Attempt to modify a frozen `Variant`") {}
+};
+
+
 ///
 /// User tried to get a type which is not able to hold the actual value
 ///
@@ -90,7 +113,7 @@ public:
 ///
 class Variant {
 public:
-    using Map = std::unordered_map<std::string, Variant>;
+    using Map = StringMap<Variant>;
     using Vec = std::vector<Variant>;
 
     Variant();
@@ -134,15 +157,29 @@ public:
     Variant& operator=(Variant const& rhs);
 
     // move
+    // \note not checked against freezing: moving from or into a value of
+    // a frozen parent, through a reference taken before `freeze()`,
+    // outdates the hash the parent cached
     Variant(Variant&& rhs) noexcept;
     Variant& operator=(Variant&& rhs) noexcept;
 
+    ///
+    /// Is there no value
+    ///
+    bool empty() const noexcept;
+
     ///
     /// Get as `T` or `x` if the object is empty
     ///
     template <typename T>
     T asOr(T x) const;
 
+    ///
+    /// Can the value be got as `T`, one of `Types`, without throwing
+    ///
+    template <typename T>
+    bool is() const noexcept;
+
     ///
     /// Get bool
     /// \throw `VariantEmpty`, `VariantBadType`, `VariantIntegralOverflow`
@@ -279,6 +316,12 @@ public:
     Vec const& vec() const;
     explicit operator Vec const&() const { return vec(); }
 
+    ///
+    /// Get Vec for modification, thawing the object
+    /// \throw `VariantEmpty`, `VariantBadType`, `VariantFrozen`
+    ///
+    Vec& vecMut();
+
     ///
     /// Get Vec or `x` if the object is empty
     /// \throw `VariantBadType`, `VariantIntegralOverflow`
@@ -292,13 +335,149 @@ public:
     Map const& map() const;
     explicit operator Map const&() const { return map(); }
 
+    ///
+    /// Get Map for modification, thawing the object
+    /// \throw `VariantEmpty`, `VariantBadType`, `VariantFrozen`
+    ///
+    Map& mapMut();
+
     ///
     /// Get Map or `x` if the object is empty
     /// \throw `VariantBadType`, `VariantIntegralOverflow`
     ///
     Map mapOr(Map const& x) const;
 
+    /// \defgroup Editing In place modification
+    /// An empty object becomes the container the call implies. Like
+    /// `mapMut()` and `vecMut()` these thaw the object and throw
+    /// `VariantFrozen` inside a frozen one.
+    /// \{
+
+    /// Member `key`, inserted empty when missing
+    /// \throw `VariantBadType` if not a `Map`
+    Variant& operator[](std::string_view key);
+
+    /// Insert `x` as `key` unless present
+    /// \throw `VariantBadType` if not a `Map`
+    std::pair<Map::iterator, bool> emplace(std::string key, Variant x);
+
+    /// \throw `VariantBadType` if not a `Vec`
+    void push_back(Variant x);
+
+    /// \return the number of members erased
+    /// \throw `VariantEmpty`, `VariantBadType` if not a `Map`
+    std::size_t erase(std::string_view key);
+
+    /// Erase the element at `index`
+    /// \throw `VariantEmpty`, `VariantBadType` if not a `Vec`,
+    /// `std::out_of_range`
+    void erase(std::size_t index);
+
+    /// \throw `VariantEmpty`, `VariantBadType` if not a `Vec` or a `Map`
+    void reserve(std::size_t n);
+    /// \}
+
+    /// \defgroup Path Nested values, see `path.hpp`
+    /// \{
+
+    /// The value at `path`, nullptr if there is none
+    Variant const* find(Path const& path) const noexcept;
+
+    /// \throw `PathError` if there is no value at `path`
+    Variant const& at(Path const& path) const;
+    /// \}
+
+    ///
+    /// Structural hash, independent of the order of `Map` entries
+    ///
+    /// Cached by frozen values only, computed on every call otherwise.
+    /// \throw `std::bad_alloc` walking more than 32 levels
+    ///
+    std::uint64_t hash() const;
+
+    ///
+    /// Structural hash of every value of the tree, children first
+    ///
+    /// For algorithms comparing many subtrees, like `diff`, without
+    /// freezing them.
+    ///
+    void hashEach(
+        std::function<void(Variant const&, std::uint64_t)> const& f) const;
+
+    /// \defgroup Freezing Immutable values with cached hashes
+    ///
+    /// `freeze()` caches the hashes of the value and of its children,
+    /// which become immutable: modifying them, even through references
+    /// taken before, throws `VariantFrozen`. Moves are not checked, a value
+    /// moved out of a frozen one stays frozen on its own. The frozen value itself is
+    /// thawed by its next modification, its children then by theirs.
+    /// Copies are not frozen.
+    /// \{
+    void freeze();
+    bool frozen() const noexcept;
+    /// \}
+
+    ///
+    /// Depth first traversal with an explicit stack
+    ///
+    /// Calls `visitor.enter(x, key, index)` on every value `x` and
+    /// `visitor.leave(x, key, index)` after its children, `key` being the
+    /// `Map` key of `x` or nullptr and `index` its position in its parent.
+    /// The children of `x` are skipped when `enter` returns false. Any depth
+    /// of nesting is walked in constant C++ stack, the tree must not be
+    /// modified meanwhile.
+    ///
+    template <typename Visitor>
+    void walk(Visitor&& visitor) const;
+
+    /// Shape and footprint of a tree, see `stats()`
+    struct Stats {
+        /// \defgroup Nodes by type
+        /// \{
+        std::size_t nulls{0};
+        std::size_t booleans{0};
+        std::size_t integers{0};
+        std::size_t floatings{0};
+        std::size_t strings{0};
+        std::size_t vecs{0};
+        std::size_t maps{0};
+        /// \}
+
+        /// Nodes on the longest path from the root, included
+        std::size_t max_depth{0};
+
+        /// `key_lengths[i]` counts the `Map` keys with `2^(i-1) <= size < 2^i`,
+        /// the last bucket the longer ones
+        std::array<std::size_t, 8> key_lengths{};
+
+        /// Heap blocks held by the tree
+        std::size_t allocations{0};
+
+        /// Bytes held by the tree, see `memoryUsage()`
+        std::size_t bytes{0};
+
+        std::size_t nodes() const noexcept {
+            return nulls + booleans + integers + floatings + strings + vecs + maps;
+        }
+    };
+
+    ///
+    /// Deep size of the tree in bytes
+    ///
+    /// Counts the nodes and the capacity of the strings beyond their small
+    /// buffer, of the vectors and of the maps with their keys and index.
+    /// Takes one walk of the tree, without allocating for shallow ones.
+    ///
+    std::size_t memoryUsage() const;
+
+    /// Node counts, depth, key lengths and footprint of the tree
+    Stats stats() const;
+
     /// \defgroup Variant equality comparison
+    /// Unequal hashes of frozen values decide without visiting them
+    /// Integers are compared by value, `Variant(1) == Variant(1L)`
+    /// \note trees deeper than 32 levels allocate, `std::terminate` if
+    /// that fails
     /// \{
     bool operator==(Variant const& rhs) const noexcept;
     bool operator!=(Variant const& rhs) const noexcept;
@@ -319,9 +498,31 @@ public:
     std::string toJson() const;
     /// \}
 
+    /// \defgroup Cbor
+    /// \ingroup Formats
+    /// Byte strings are decoded into `std::string`
+    /// \{
+    /// \throw `cbor::CborError` on malformed input
+    static Variant fromCbor(std::string_view cbor);
+
+    /// Append the encoded value to a CBOR stream
+    cbor::Writer& to(cbor::Writer& cbor) const;
+
+    std::string toCbor() const;
+    /// \}
+
+    ///
+    /// Append the text `operator<<` prints to `out`
+    /// Floating values have six decimals, like `std::to_string`
+    ///
+    void appendTo(std::string& out) const;
+
     ///
     /// Stream operator
     ///
+    /// \note the stream state is not used, doubles are printed with six
+    /// fixed decimals as by `std::to_string`
+    ///
     friend std::ostream& operator<<(std::ostream& os, Variant const& var);
 
     /// \defgroup type_info
@@ -330,7 +531,8 @@ public:
     std::type_info const& typeInfo() const;
     /// \}
 
-    /// List of supported types
+    /// List of supported types, the integral ones are stored as 64 bit
+    /// values converted back on access, `typeInfo()` tells the original one
     using Types = S<
         bool,
         char,
@@ -347,14 +549,69 @@ public:
 
 private:
     struct Impl;
+
+    /// Drop the cache of a frozen value before its modification
+    /// \throw `VariantFrozen` if its parent is frozen
+    void thaw();
+
+    template <typename F>
+    std::uint64_t hashTree(F&& f, bool every) const;
+
     Pimpl<Impl> impl;
 };
 
 
-using VariantMap = std::unordered_map<std::string, Variant>;
+using VariantMap = StringMap<Variant>;
 using VariantVec = std::vector<Variant>;
 
 
+template <typename Visitor>
+void Variant::walk(Visitor&& visitor) const {
+    struct Frame {
+        Variant const* x;
+        std::string const* key;
+        std::size_t index;
+        Vec const* vec;
+        Map const* map;
+        Map::const_iterator entry;
+        std::size_t next;
+    };
+
+    // shallow trees are walked without allocating
+    boost::container::small_vector<Frame, 32> stack;
+
+    auto const visit = [&](Variant const& x, std::string const* key,
+                           std::size_t index) {
+        if (!visitor.enter(x, key, index)) {
+            visitor.leave(x, key, index);
+        } else if (x.is<Vec>()) {
+            stack.push_back(Frame{&x, key, index, &x.vec(), nullptr, {}, 0});
+        } else if (x.is<Map>()) {
+            auto const& map = x.map();
+            stack.push_back(Frame{&x, key, index, nullptr, &map, map.begin(), 0});
+        } else {
+            visitor.leave(x, key, index);
+        }
+    };
+
+    visit(*this, nullptr, 0);
+    while (!stack.empty()) {
+        auto& top = stack.back();
+        auto const i = top.next++;
+        if (top.vec && i < top.vec->size()) {
+            visit((*top.vec)[i], nullptr, i);
+        } else if (top.map && top.entry != top.map->end()) {
+            auto const entry = *top.entry++;
+            visit(entry.second, &entry.first, i);
+        } else {
+            auto const done = top;
+            stack.pop_back();
+            visitor.leave(*done.x, done.key, done.index);
+        }
+    }
+}
+
+
 template <> inline bool Variant::asOr<bool>(bool x) const { return booleanOr(x); }
 template <> inline char Variant::asOr<char>(char x) const { return characterOr(x); }
 template <> inline short int Variant::asOr<short int>(short int x) const { return shortIntOr(x); }
@@ -365,4 +622,18 @@ template <> inline signed long Variant::asOr<signed long>(signed long x) const {
 template <> inline unsigned long Variant::asOr<unsigned long>(unsigned long x) const { return ulongIntOr(x); }
 
 
+}
+
+
+namespace std {
+
+
+template <>
+struct hash<serialize::Variant> {
+    size_t operator()(serialize::Variant const& x) const {
+        return static_cast<size_t>(x.hash());
+    }
+};
+
+
 }
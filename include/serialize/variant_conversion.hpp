@@ -28,6 +28,7 @@
 
 // local
 #include <serialize/config.hpp>
+#include <serialize/field_names.hpp>
 #include <serialize/meta.hpp>
 #include <serialize/variant.hpp>
 #include <serialize/when.hpp>
@@ -41,7 +42,14 @@
 #include <boost/hana.hpp>
 
 // std
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
 #include <type_traits>
+#include <utility>
+#include <variant>
 
 
 namespace serialize {
@@ -123,29 +131,41 @@ struct ToVariantImpl<T, When<condition>> {
 template <typename T>
 struct ToVariantImpl<T, When<hasToVariant(type_c<T>)>> {
     static Variant apply(T const& x) { return T::toVariant(x); }
+    static Variant apply(T&& x) { return T::toVariant(std::move(x)); }
 };
 
 
 /// Specialization for Variant build-in supported types
 template <typename T>
 struct ToVariantImpl<T, When<Variant::Types::convertible<T>()>> {
-    static Variant apply(T x) { return Variant(x); }
+    static Variant apply(T const& x) { return Variant(x); }
+    static Variant apply(T&& x) { return Variant(std::move(x)); }
 };
 
 
 /// Specialization for map types
+/// The keys are strings, they go straight into the `Variant::Map`
 template <typename T>
 struct ToVariantImpl<T,
         When<isContainer(type_c<T>) &&
              isKeyValue(type_c<typename T::value_type>)>> {
-    static Variant apply(T const& map) {
+    static Variant apply(T const& map) { return build(map); }
+    static Variant apply(T&& map) { return build(std::move(map)); }
+
+private:
+    template <typename U>
+    static Variant build(U&& map) {
         VariantMap ret;
-        for (auto const& x: map) {
+        if constexpr (hasSize(boost::hana::type_c<T>)) {
+            ret.reserve(map.size());
+        }
+        for (auto& x: map) {
             ret.emplace(
-                ToVariantImpl<typename T::key_type>::apply(x.first),
-                ToVariantImpl<typename T::mapped_type>::apply(x.second));
+                x.first,
+                ToVariantImpl<typename T::mapped_type>::apply(
+                    forwardLike<U>(x.second)));
         }
-        return Variant(ret);
+        return Variant(std::move(ret));
     }
 };
 
@@ -155,12 +175,25 @@ template <typename T>
 struct ToVariantImpl<T,
         When<isContainer(type_c<T>) &&
              !isKeyValue(type_c<typename T::value_type>)>> {
-    static Variant apply(T const& vec) {
+    static Variant apply(T const& vec) { return build(vec); }
+    static Variant apply(T&& vec) { return build(std::move(vec)); }
+
+private:
+    template <typename U>
+    static Variant build(U&& vec) {
         VariantVec ret;
-        for (auto const& x: vec) {
-            ret.push_back(toVariant(x));
+        if constexpr (hasSize(boost::hana::type_c<T>)) {
+            ret.reserve(vec.size());
+        }
+        for (auto&& x: vec) {
+            if constexpr (std::is_lvalue_reference_v<decltype(x)>) {
+                ret.push_back(toVariant(forwardLike<U>(x)));
+            } else {
+                // proxy references
+                ret.push_back(toVariant(x));
+            }
         }
-        return Variant(ret);
+        return Variant(std::move(ret));
     }
 };
 
@@ -256,10 +289,129 @@ template <typename T>
 struct ToVariantImpl<T, When<hanaMap(type_c<T>)>> {
     static Variant apply(T const& map) {
         Variant::Map ret;
-        boost::hana::for_each(map, boost::hana::fuse([&ret](auto key, auto value) {
-            ret[boost::hana::to<char const*>(key)] = toVariant(value);
-        }));
-        return Variant(ret);
+        ret.reserve(decltype(boost::hana::length(map))::value);
+        boost::hana::for_each(map, [&ret](auto const& x) {
+            ret.emplace(boost::hana::to<char const*>(boost::hana::first(x)),
+                        toVariant(boost::hana::second(x)));
+        });
+        return Variant(std::move(ret));
+    }
+};
+
+
+///
+/// Key of the discriminator of the tagged union `V`
+///
+/// Specialize to change it for a particular `std::variant`
+///
+template <typename V>
+struct UnionDiscriminator {
+    static constexpr std::string_view key = "type";
+};
+
+
+/// Does a type has a static member function `unionTag()`
+constexpr auto const hasUnionTag = boost::hana::is_valid(
+    [](auto t) -> decltype((void) decltype(t)::type::unionTag()) {});
+
+
+struct TaggedUnionT {
+    template <typename ...Ts>
+    constexpr bool operator()(Type<std::variant<Ts...>> const&) const {
+        return (hasUnionTag(boost::hana::type_c<Ts>) && ...);
+    }
+
+    template <typename T>
+    constexpr bool operator()(Type<T> const&) const { return false; }
+};
+
+
+/// Is the type a `std::variant` whose every alternative has `unionTag()`
+constexpr TaggedUnionT taggedUnion;
+
+
+///
+/// Tags of the alternatives of the tagged union `V`, with their hashes and
+/// perfect hash computed at compile time
+///
+template <typename V>
+struct UnionTags;
+
+
+template <typename ...Ts>
+struct UnionTags<std::variant<Ts...>> {
+    static constexpr std::size_t size = sizeof...(Ts);
+
+    static constexpr std::array<std::string_view, size> names = {
+        std::string_view(Ts::unionTag())...
+    };
+
+    static constexpr std::array<std::uint64_t, size> hashes =
+            detail::fieldHashes(names);
+
+    static constexpr detail::PerfectHash<size> perfect =
+            detail::perfectHash(hashes);
+
+    static_assert(perfect.ok, "The alternatives have duplicate tags");
+
+    static constexpr PrehashedKey discriminator =
+            UnionDiscriminator<std::variant<Ts...>>::key;
+
+    /// Index of the alternative tagged `key`, `size` if there is none
+    static constexpr std::size_t find(PrehashedKey key) noexcept {
+        auto const i = perfect.find(key.hash);
+        return i < size && names[i] == key.name ? i : size;
+    }
+
+private:
+    /// Does the reflected `T` have a member named as the discriminator
+    template <typename T>
+    static constexpr bool clashes() {
+        if constexpr (boost::hana::Struct<T>::value) {
+            return FieldNames<T>::find(discriminator) != FieldNames<T>::size;
+        } else {
+            return false;
+        }
+    }
+
+    static_assert(!(clashes<Ts>() || ...),
+                  "An alternative has a member named as the discriminator");
+};
+
+
+///
+/// Specialization for tagged unions
+///
+/// An alternative is its own map plus the discriminator holding its tag
+/// \throw `std::logic_error` if the map of the alternative has the key
+///
+template <typename T>
+struct ToVariantImpl<T, When<taggedUnion(type_c<T>)>> {
+    static Variant apply(T const& x) {
+        return std::visit([](auto const& alt) {
+            using Alt = std::decay_t<decltype(alt)>;
+            return tagged(toVariant(alt), Alt::unionTag());
+        }, x);
+    }
+
+    static Variant apply(T&& x) {
+        return std::visit([](auto&& alt) {
+            using Alt = std::decay_t<decltype(alt)>;
+            return tagged(toVariant(std::move(alt)), Alt::unionTag());
+        }, std::move(x));
+    }
+
+private:
+    static Variant tagged(Variant x, std::string_view tag) {
+        using namespace std::literals;
+
+        auto const& key = UnionTags<T>::discriminator;
+        if (!x.mapMut().try_emplace(key, Variant(std::string(tag))).second) {
+            throw std::logic_error(
+                std::string(key.name) + " of '"s + std::string(tag) +
+                "' clashes with the discriminator"s);
+        }
+        return x;
     }
 };
 
@@ -320,7 +472,11 @@ struct FromVariantImpl<T, When<
         hasPushBack(boost::hana::type_c<T>)>> {
     static T apply(Variant const& var) {
         T ret;
-        for (auto const& x: var.vec()) {
+        auto const& vec = var.vec();
+        if constexpr (hasReserve(boost::hana::type_c<T>)) {
+            ret.reserve(vec.size());
+        }
+        for (auto const& x: vec) {
             ret.push_back(fromVariant<typename T::value_type>(x));
         }
         return ret;
@@ -349,12 +505,24 @@ struct FromVariantImpl<T, When<
 template <typename T>
 struct FromVariantImpl<T, When<isContainer(type_c<T>) &&
         isKeyValue(type_c<typename T::value_type>)>> {
+    using K = typename T::key_type;
+
     static T apply(Variant const& var) {
         T ret;
-        for (auto const& x: var.map()) {
-            ret.emplace(
-                FromVariantImpl<typename T::key_type>::apply(Variant(x.first)),
-                FromVariantImpl<typename T::mapped_type>::apply(x.second));
+        auto const& map = var.map();
+        if constexpr (hasReserve(boost::hana::type_c<T>)) {
+            ret.reserve(map.size());
+        }
+        for (auto const& x: map) {
+            if constexpr (std::is_constructible_v<K, std::string const&>) {
+                ret.emplace(
+                    x.first,
+                    FromVariantImpl<typename T::mapped_type>::apply(x.second));
+            } else {
+                ret.emplace(
+                    FromVariantImpl<K>::apply(Variant(x.first)),
+                    FromVariantImpl<typename T::mapped_type>::apply(x.second));
+            }
         }
         return ret;
     }
@@ -413,7 +581,7 @@ struct FromVariantImpl<T, When<boolean(type_c<T>)>> {
 template <typename T>
 struct FromVariantImpl<T, When<hanaMap(type_c<T>)>> {
     static T apply(Variant const& var) {
-        auto const map = var.map();
+        auto const& map = var.map();
         T ret;
         boost::hana::for_each(ret,
                               boost::hana::fuse([&](auto key, auto& value) {
@@ -440,10 +608,193 @@ struct FromVariantImpl<T, When<boost::hana::Constant<T>().value>> {
 };
 
 
+/// Specialization for tagged unions
+/// Only the alternative named by the discriminator is converted
+template <typename T>
+struct FromVariantImpl<T, When<taggedUnion(type_c<T>)>> {
+    using Tags = UnionTags<T>;
+
+    static T apply(Variant const& x) {
+        using namespace std::literals;
+
+        auto const& map = x.map();
+        auto const it = map.find(Tags::discriminator);
+        if (it == map.end()) {
+            throw std::logic_error(
+                std::string(Tags::discriminator.name) + " not found in map"s);
+        }
+
+        auto const& tag = it->second.str();
+        auto const i = Tags::find(tag);
+        if (i == Tags::size) {
+            throw std::logic_error("'" + tag + "'" + " no such alternative");
+        }
+
+        return convert(i, x, std::make_index_sequence<Tags::size>());
+    }
+
+private:
+    template <std::size_t ...I>
+    static T convert(std::size_t i, Variant const& x, std::index_sequence<I...>) {
+        using Fn = T (*)(Variant const&);
+        static constexpr Fn table[] = {
+            [](Variant const& y) {
+                using Alt = std::variant_alternative_t<I, T>;
+                return T(std::in_place_index<I>, fromVariant<Alt>(y));
+            }...
+        };
+        return table[i](x);
+    }
+};
+
+
 template <typename T>
 auto FromVariantT<T>::operator()(Variant const& x) const {
     return FromVariantImpl<std::decay_t<T>>::apply(x);
 }
 
 
+template <typename T>
+struct HasFromVariantIntoImpl {
+    template <typename U, typename = decltype(U::fromVariantInto(
+              std::declval<U&>(), std::declval<Variant const&>()))>
+    static std::true_type test(Type<U> const&);
+    static std::false_type test(...);
+    static constexpr auto const value = decltype(test(type_c<T>))();
+};
+
+
+struct HasFromVariantIntoT {
+    template <typename T>
+    constexpr auto operator()(Type<T> const&) const {
+        return HasFromVariantIntoImpl<std::decay_t<T>>::value;
+    }
+};
+
+
+/// Tests if type has void T::fromVariantInto(T&, Variant)
+constexpr HasFromVariantIntoT hasFromVariantInto;
+
+
+struct FromVariantIntoT {
+    template <typename T>
+    void operator()(T& x, Variant const& var) const;
+};
+
+
+///
+/// Converts `var` into the existing `x`
+///
+/// Strings, sequences, maps and reflected structs are assigned member-wise,
+/// keeping the capacity and the nodes `x` already owns
+///
+constexpr FromVariantIntoT fromVariantInto;
+
+
+/// Unified conversion of Variant into an existing T
+template <typename T, typename = void>
+struct FromVariantIntoImpl : FromVariantIntoImpl<T, When<true>> {};
+
+
+/// Fallback, assigns a fresh object
+template <typename T, bool condition>
+struct FromVariantIntoImpl<T, When<condition>> {
+    static void apply(T& x, Variant const& var) {
+        x = FromVariantImpl<T>::apply(var);
+    }
+};
+
+
+/// Specialization for types with `static void T::fromVariantInto(T&, Variant)`
+template <typename T>
+struct FromVariantIntoImpl<T, When<hasFromVariantInto(type_c<T>)>> {
+    static void apply(T& x, Variant const& var) { T::fromVariantInto(x, var); }
+};
+
+
+/// Specialization for strings
+template <typename T>
+struct FromVariantIntoImpl<T, When<std::is_same_v<T, std::string>>> {
+    static void apply(T& x, Variant const& var) { x.assign(var.str()); }
+};
+
+
+/// Specialization for optional types, empty when the variant is
+template <typename T>
+struct FromVariantIntoImpl<T, When<isOptional(type_c<T>)>> {
+    static void apply(T& x, Variant const& var) {
+        if (var.empty()) {
+            x.reset();
+        } else if (x.has_value()) {
+            fromVariantInto(*x, var);
+        } else {
+            x.emplace(fromVariant<typename T::value_type>(var));
+        }
+    }
+};
+
+
+/// Specialization for resizable sequences
+/// The elements kept are converted in place
+template <typename T>
+struct FromVariantIntoImpl<T, When<
+        !hasFromVariantInto(type_c<T>) &&
+        isContainer(type_c<T>) &&
+        !isKeyValue(type_c<typename T::value_type>) &&
+        hasResize(boost::hana::type_c<T>) &&
+        std::is_default_constructible_v<typename T::value_type> &&
+        !std::is_same_v<typename T::value_type, bool>>> {
+    static void apply(T& x, Variant const& var) {
+        auto const& vec = var.vec();
+        x.resize(vec.size());
+        auto it = vec.begin();
+        for (auto& y: x) { fromVariantInto(y, *it++); }
+    }
+};
+
+
+/// Specialization for map types with string keys
+/// The entries with keys kept are converted in place
+template <typename T>
+struct FromVariantIntoImpl<T, When<
+        !hasFromVariantInto(type_c<T>) &&
+        isContainer(type_c<T>) &&
+        isKeyValue(type_c<typename T::value_type>) &&
+        std::is_same_v<typename T::key_type, std::string>>> {
+    static void apply(T& x, Variant const& var) {
+        auto const& map = var.map();
+        for (auto it = x.begin(); it != x.end();) {
+            if (map.count(it->first) == 0) {
+                it = x.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        for (auto const& y: map) {
+            auto const it = x.find(y.first);
+            if (it == x.end()) {
+                x.emplace(y.first,
+                          fromVariant<typename T::mapped_type>(y.second));
+            } else {
+                fromVariantInto(it->second, y.second);
+            }
+        }
+    }
+};
+
+
+template <typename T>
+void FromVariantIntoT::operator()(T& x, Variant const& var) const {
+    FromVariantIntoImpl<T>::apply(x, var);
+}
+
+
+/// Parses `json` into the existing `x`, see `fromVariantInto`
+template <typename T>
+void fromJsonInto(T& x, std::string const& json) {
+    fromVariantInto(x, Variant::fromJson(json));
+}
+
+
 }
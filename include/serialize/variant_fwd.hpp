@@ -26,16 +26,18 @@
 #pragma once
 
 
+// local
+#include <serialize/string_map.hpp>
+
 // std
 #include <vector>
-#include <unordered_map>
 
 
 namespace serialize {
 
 
 class Variant;
-using VariantMap = std::unordered_map<std::string, Variant>;
+using VariantMap = StringMap<Variant>;
 using VariantVec = std::vector<Variant>;
 
 
@@ -27,6 +27,7 @@
 
 
 // local
+#include <serialize/field_names.hpp>
 #include <serialize/meta.hpp>
 #include <serialize/variant.hpp>
 #include <serialize/variant_conversion.hpp>
@@ -35,6 +36,8 @@
 #include <boost/hana.hpp>
 
 // std
+#include <array>
+#include <string>
 #include <type_traits>
 
 
@@ -99,6 +102,26 @@ constexpr bool hasDefaultValue(S name) {
 }
 
 
+/// An immutable `T` holding `T::defaults()` in every defaulted member
+///
+/// Built once per type on first use, so missing and elided fields copy or
+/// compare a ready member instead of evaluating `defaults()` again.
+template <typename T>
+T const& prototype() {
+    static T const ret = [] {
+        T x;
+        boost::hana::for_each(boost::hana::accessors<T>(),
+                              boost::hana::fuse([&](auto name, auto get) {
+            if constexpr (hasDefaultValue<T>(name)) {
+                get(x) = T::defaults()[name];
+            }
+        }));
+        return x;
+    }();
+    return ret;
+}
+
+
 template <typename T>
 constexpr void checkOrphanKeys(Type<T> const&) {
     constexpr decltype(boost::hana::keys(T::defaults())) keys;
@@ -125,6 +148,27 @@ auto fromVariantWrap(Variant const& x) {
 }
 
 
+template <typename T>
+void fromVariantIntoWrap(T& x, Variant const& var) {
+    fromVariantInto(x, var);
+}
+
+
+/// Entries of `map` for the members of `T` in declaration order, `map.end()`
+/// for the absent ones, found in one walk of the map
+template <typename T>
+auto memberEntries(Variant::Map const& map) {
+    using Names = FieldNames<T>;
+    std::array<Variant::Map::const_iterator, Names::size> ret;
+    ret.fill(map.end());
+    for (auto it = map.begin(); it != map.end(); ++it) {
+        auto const i = Names::find(map.key(it));
+        if (i != Names::size) { ret[i] = it; }
+    }
+    return ret;
+}
+
+
 } // namespace detail
 
 
@@ -138,57 +182,69 @@ auto fromVariantWrap(Variant const& x) {
 /// and, for the method `toVariant` all fields will be serialized into a variant
 template <typename Derived>
 struct Var {
-    static Variant toVariant(Derived const& x) {
-        Variant::Map ret;
+    static Variant toVariant(Derived const& x) { return toVariantImpl(x); }
 
-        boost::hana::for_each(x, boost::hana::fuse([&](auto name, auto value) {
-            if constexpr (isOptional(type_c<decltype(value)>)) {
-                if (value.has_value()) {
-                    ret[boost::hana::to<char const*>(name)] =
-                            detail::toVariantWrap(*value);
-                } else {
-                    ret[boost::hana::to<char const*>(name)] = Variant();
-                }
-            } else {
-                ret[boost::hana::to<char const*>(name)] =
-                        detail::toVariantWrap(value);
-            }
-        }));
-
-        return Variant(ret);
+    /// Moves the members out of `x`
+    static Variant toVariant(Derived&& x) {
+        return toVariantImpl(std::move(x));
     }
 
     static Derived fromVariant(Variant const& x) {
-        using namespace std::literals;
         Derived ret;
+        fromVariantInto(ret, x);
+        return ret;
+    }
+
+    /// Assigns the members of the existing `ret`, reusing what they own
+    /// The members are converted in declaration order, the first one
+    /// missing or not converting throws
+    static void fromVariantInto(Derived& ret, Variant const& x) {
+        using namespace std::literals;
+
         auto const& map = x.map();
+        auto const entries = detail::memberEntries<Derived>(map);
+        std::size_t i = 0;
 
         boost::hana::for_each(boost::hana::accessors<Derived>(),
-                       boost::hana::fuse([&](auto name, auto value) {
-            auto& tmp = value(ret);
-            auto const it = map.find(boost::hana::to<char const*>(name));
-            if (map.end() == it) {
+                              boost::hana::fuse([&](auto name, auto value) {
+            auto const it = entries[i++];
+            if (it == map.end()) {
                 throw std::logic_error(
-                            boost::hana::to<char const*>(name) +
-                            " not found in map"s);
-            } else {
-                if constexpr (isOptional(type_c<decltype(tmp)>)) {
-                    if (it->second.empty()) {
-                        return;
-                    } else {
-                        tmp = detail::fromVariantWrap<decltype(*tmp)>(it->second);
-                    }
-                } else {
-                    tmp = detail::fromVariantWrap<decltype(tmp)>(it->second);
-                }
+                    boost::hana::to<char const*>(name) + " not found in map"s);
             }
+            detail::fromVariantIntoWrap(value(ret), it->second);
         }));
-
-        return ret;
     }
 
 protected:
     ~Var() = default;
+
+private:
+    template <typename Self>
+    static Variant toVariantImpl(Self&& x) {
+        Variant::Map ret;
+        ret.reserve(FieldNames<Derived>::size);
+        std::size_t i = 0;
+
+        boost::hana::for_each(boost::hana::accessors<Derived>(),
+                              boost::hana::fuse([&](auto, auto get) {
+            auto const key = FieldNames<Derived>::key(i++);
+            auto& value = get(x);
+            if constexpr (isOptional(type_c<std::decay_t<decltype(value)>>)) {
+                if (value.has_value()) {
+                    ret.try_emplace(
+                        key, detail::toVariantWrap(forwardLike<Self>(*value)));
+                } else {
+                    ret.try_emplace(key, Variant());
+                }
+            } else {
+                ret.try_emplace(
+                    key, detail::toVariantWrap(forwardLike<Self>(value)));
+            }
+        }));
+
+        return Variant(std::move(ret));
+    }
 };
 
 
@@ -209,53 +265,35 @@ struct VarDefPolicy {
 /// to the corresponding members.
 template <typename Derived, class Policy = VarDefPolicy>
 struct VarDef {
-    static Variant toVariant(Derived const& x) {
-        Variant::Map ret;
-
-        boost::hana::for_each(x, boost::hana::fuse([&](auto name, auto value) {
-            if constexpr (isOptional(type_c<decltype(value)>)) {
-                if (value.has_value()) {
-                    ret[boost::hana::to<char const*>(name)] =
-                            detail::toVariantWrap(*value);
-                }
-            } else {
-                if constexpr (!Policy::serialize_default_value &&
-                              detail::hasDefaultValue<Derived>(name)) {
-                    if (Derived::defaults()[name] == value) { return; }
-                }
-
-                if constexpr(detail::isContainer(
-                                 boost::hana::type_c<decltype(value)>)) {
-                    if constexpr (Policy::serialize_empty_container) {
-                        ret[boost::hana::to<char const*>(name)] =
-                                detail::toVariantWrap(value);
-                    } else if (begin(value) != end(value)) {
-                        ret[boost::hana::to<char const*>(name)] =
-                                detail::toVariantWrap(value);
-                    }
-                } else {
-                    ret[boost::hana::to<char const*>(name)] =
-                            detail::toVariantWrap(value);
-                }
-            }
-        }));
+    static Variant toVariant(Derived const& x) { return toVariantImpl(x); }
 
-        return Variant(ret);
+    /// Moves the members out of `x`
+    static Variant toVariant(Derived&& x) {
+        return toVariantImpl(std::move(x));
     }
 
     static Derived fromVariant(Variant const& x) {
+        Derived ret;
+        fromVariantInto(ret, x);
+        return ret;
+    }
+
+    /// Assigns the members of the existing `ret`, reusing what they own
+    /// The members are converted in declaration order, as `Var` does
+    static void fromVariantInto(Derived& ret, Variant const& x) {
         using namespace std::literals;
         using namespace boost::hana::literals;
 
-        Derived ret;
         auto const& map = x.map();
+        auto const entries = detail::memberEntries<Derived>(map);
+        std::size_t i = 0;
 
         boost::hana::for_each(boost::hana::accessors<Derived>(),
                        boost::hana::fuse([&](auto name, auto value) {
-            auto& tmp = value(ret);
-            auto const it = map.find(boost::hana::to<char const*>(name));
-
-            if (map.end() == it) {
+            auto const it = entries[i++];
+            if (it != map.end()) {
+                detail::fromVariantIntoWrap(value(ret), it->second);
+            } else {
                 if constexpr (detail::hasDefaultValue<Derived>(name)) {
                     BOOST_HANA_CONSTEXPR_ASSERT_MSG(
                         (std::is_convertible_v<
@@ -265,29 +303,65 @@ struct VarDef {
                         " defaults() for "_s + name +
                         " does not match with the actual type"_s);
 
-                    tmp = Derived::defaults()[name];
+                    value(ret) = value(detail::prototype<Derived>());
                 } else if constexpr (
-                            !isOptional(type_c<decltype(tmp)>)) {
+                            !isOptional(type_c<decltype(value(ret))>)) {
                     throw std::logic_error(
                                 boost::hana::to<char const*>(name) +
                                 " not found in map, and default"
                                 " value is not provided"s);
+                } else {
+                    value(ret).reset();
                 }
+            }
+        }));
+    }
+
+protected:
+    ~VarDef() = default;
+
+private:
+    template <typename Self>
+    static Variant toVariantImpl(Self&& x) {
+        Variant::Map ret;
+        ret.reserve(FieldNames<Derived>::size);
+        std::size_t i = 0;
 
+        boost::hana::for_each(boost::hana::accessors<Derived>(),
+                              boost::hana::fuse([&](auto name, auto get) {
+            auto const key = FieldNames<Derived>::key(i++);
+            auto& value = get(x);
+            using T = std::decay_t<decltype(value)>;
+            if constexpr (isOptional(type_c<T>)) {
+                if (value.has_value()) {
+                    ret.try_emplace(
+                        key, detail::toVariantWrap(forwardLike<Self>(*value)));
+                }
             } else {
-                if constexpr (isOptional(type_c<decltype(tmp)>)) {
-                    tmp = detail::fromVariantWrap<decltype(*tmp)>(it->second);
+                if constexpr (!Policy::serialize_default_value &&
+                              detail::hasDefaultValue<Derived>(name)) {
+                    if (get(detail::prototype<Derived>()) == value) {
+                        return;
+                    }
+                }
+
+                if constexpr(detail::isContainer(boost::hana::type_c<T>)) {
+                    if constexpr (Policy::serialize_empty_container) {
+                        ret.try_emplace(
+                            key, detail::toVariantWrap(forwardLike<Self>(value)));
+                    } else if (begin(value) != end(value)) {
+                        ret.try_emplace(
+                            key, detail::toVariantWrap(forwardLike<Self>(value)));
+                    }
                 } else {
-                    tmp = detail::fromVariantWrap<decltype(tmp)>(it->second);
+                    ret.try_emplace(
+                        key, detail::toVariantWrap(forwardLike<Self>(value)));
                 }
             }
         }));
 
-        return ret;
+        return Variant(std::move(ret));
     }
-
-protected:
-    ~VarDef() = default;
 };
 
 
@@ -311,11 +385,21 @@ struct VarDefExplicit : private VarDef<Derived> {
         return VarDef<Derived>::fromVariant(x);
     }
 
+    static void fromVariantInto(Derived& ret, Variant const& x) {
+        check();
+        VarDef<Derived>::fromVariantInto(ret, x);
+    }
+
     static Variant toVariant(Derived const& x) {
         check();
         return VarDef<Derived>::toVariant(x);
     }
 
+    static Variant toVariant(Derived&& x) {
+        check();
+        return VarDef<Derived>::toVariant(std::move(x));
+    }
+
     static constexpr void check() {
         using namespace boost::hana::literals;
 
@@ -349,19 +433,15 @@ struct UpdateFromVar {
     void updateVar(Variant const& x) {
         Derived& self = static_cast<Derived&>(*this);
         auto const& map = x.map();
-        for (auto const& v: map) {
-            bool found{false};
-            boost::hana::for_each(boost::hana::accessors<Derived>(),
-                                  boost::hana::fuse([&](auto name, auto value) {
-                if (boost::hana::to<char const*>(name) != v.first) { return; }
-                auto& tmp = value(self);
-                tmp = detail::fromVariantWrap<decltype(tmp)>(v.second);
-                found = true;
-            }));
-
-            if (!found) {
-                throw std::logic_error("'" + v.first + "'" + " no such member");
+        for (auto it = map.begin(); it != map.end(); ++it) {
+            auto const i = FieldNames<Derived>::find(map.key(it));
+            if (i == FieldNames<Derived>::size) {
+                throw std::logic_error("'" + it->first + "'" + " no such member");
             }
+            visitField<Derived>(i, [&](auto index) {
+                detail::fromVariantIntoWrap(
+                    member<decltype(index)::value>(self), it->second);
+            });
         }
     }
 
@@ -0,0 +1,90 @@
+/*
+  MIT License
+
+  Copyright (c) 2018 Nicolai Trandafil
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+// ifce
+#include <serialize/flat.hpp>
+
+// sys
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// std
+#include <cerrno>
+#include <system_error>
+#include <utility>
+
+
+namespace serialize::flat {
+
+
+MappedFile::MappedFile(std::string const& path) {
+    auto const fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::system_error(errno, std::generic_category(), path);
+    }
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        auto const err = errno;
+        ::close(fd);
+        throw std::system_error(err, std::generic_category(), path);
+    }
+
+    size = static_cast<std::size_t>(st.st_size);
+    if (size != 0) {
+        addr = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        if (addr == MAP_FAILED) {
+            auto const err = errno;
+            addr = nullptr;
+            ::close(fd);
+            throw std::system_error(err, std::generic_category(), path);
+        }
+    }
+
+    ::close(fd);
+}
+
+
+MappedFile::~MappedFile() {
+    if (addr) { ::munmap(addr, size); }
+}
+
+
+MappedFile::MappedFile(MappedFile&& rhs) noexcept
+    : addr(std::exchange(rhs.addr, nullptr))
+    , size(std::exchange(rhs.size, 0))
+{}
+
+
+MappedFile& MappedFile::operator=(MappedFile&& rhs) noexcept {
+    std::swap(addr, rhs.addr);
+    std::swap(size, rhs.size);
+    return *this;
+}
+
+
+}
@@ -0,0 +1,245 @@
+/*
+  MIT License
+
+  Copyright (c) 2018 Nicolai Trandafil
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+// ifce
+#include <serialize/node_pool.hpp>
+
+// std
+#include <atomic>
+#include <cstdint>
+#include <new>
+#include <utility>
+
+
+namespace serialize {
+
+
+namespace {
+
+
+constexpr std::size_t granularity = 16;
+constexpr std::size_t classes = NodePool::max_size / granularity;
+
+/// Blocks kept per size class, the rest goes to the heap
+constexpr std::size_t capacity = 1024;
+
+
+struct Cache;
+
+
+/// Precedes every pooled block, keeps the payload aligned
+struct alignas(std::max_align_t) Header {
+    /// nullptr for the blocks allocated while the thread exits
+    Cache* owner;
+};
+
+
+struct Block {
+    Block* next;
+};
+
+
+struct Cache {
+    /// Touched by the owning thread only
+    Block* local[classes]{};
+    std::size_t count[classes]{};
+
+    /// Freed by other threads
+    std::atomic<Block*> remote[classes]{};
+
+    std::atomic<bool> used{true};
+    Cache* next{nullptr};
+};
+
+
+/// Never freed, other threads may still free blocks to an exited thread
+std::atomic<Cache*> caches{nullptr};
+
+
+std::size_t classOf(std::size_t size) noexcept {
+    return size == 0 ? 0 : (size - 1) / granularity;
+}
+
+
+Header* headerOf(Block* x) noexcept {
+    return reinterpret_cast<Header*>(x) - 1;
+}
+
+
+void release(Block* x) noexcept {
+    ::operator delete(headerOf(x));
+}
+
+
+Cache* adopt() {
+    for (auto x = caches.load(std::memory_order_acquire); x; x = x->next) {
+        bool expected = false;
+        if (!x->used.load(std::memory_order_relaxed) &&
+                x->used.compare_exchange_strong(expected, true,
+                                                std::memory_order_acquire)) {
+            return x;
+        }
+    }
+
+    auto const x = new Cache;
+    x->next = caches.load(std::memory_order_relaxed);
+    while (!caches.compare_exchange_weak(x->next, x,
+                                         std::memory_order_release,
+                                         std::memory_order_relaxed)) {}
+    return x;
+}
+
+
+/// Trivial, so usable while the thread exits
+thread_local Cache* current = nullptr;
+thread_local bool exiting = false;
+
+
+void drain(Cache& x) noexcept {
+    for (std::size_t k = 0; k < classes; ++k) {
+        for (auto b = x.local[k]; b;) { release(std::exchange(b, b->next)); }
+        x.local[k] = nullptr;
+        x.count[k] = 0;
+    }
+}
+
+
+/// Gives the cache of the thread up when it exits
+struct Releaser {
+    ~Releaser() {
+        exiting = true;
+        if (!current) { return; }
+        drain(*current);
+        current->used.store(false, std::memory_order_release);
+        current = nullptr;
+    }
+};
+
+
+thread_local Releaser releaser;
+
+
+Cache* cache() {
+    if (!current && !exiting) {
+        current = adopt();
+        // registers the destructor of the thread
+        static_cast<void>(&releaser);
+    }
+    return current;
+}
+
+
+/// Take the blocks freed by other threads, the overflow goes to the heap
+Block* reclaim(Cache& x, std::size_t k) noexcept {
+    auto b = x.remote[k].exchange(nullptr, std::memory_order_acquire);
+    Block* ret = nullptr;
+    while (b) {
+        auto const next = b->next;
+        if (x.count[k] < capacity) {
+            b->next = ret;
+            ret = b;
+            ++x.count[k];
+        } else {
+            release(b);
+        }
+        b = next;
+    }
+    return ret;
+}
+
+
+} // namespace
+
+
+void* NodePool::allocate(std::size_t size) {
+    if (size > max_size) { return ::operator new(size); }
+
+    auto const k = classOf(size);
+    auto const c = cache();
+    if (c) {
+        if (!c->local[k]) { c->local[k] = reclaim(*c, k); }
+        if (auto const b = c->local[k]) {
+            c->local[k] = b->next;
+            --c->count[k];
+            return b;
+        }
+    }
+
+    auto const header = static_cast<Header*>(
+        ::operator new(sizeof(Header) + (k + 1) * granularity));
+    header->owner = c;
+    return header + 1;
+}
+
+
+void NodePool::deallocate(void* p, std::size_t size) noexcept {
+    if (size > max_size) {
+        ::operator delete(p);
+        return;
+    }
+
+    auto const k = classOf(size);
+    auto const b = static_cast<Block*>(p);
+    auto const owner = headerOf(b)->owner;
+    if (!owner) {
+        release(b);
+    } else if (owner == current) {
+        if (owner->count[k] < capacity) {
+            b->next = owner->local[k];
+            owner->local[k] = b;
+            ++owner->count[k];
+        } else {
+            release(b);
+        }
+    } else {
+        auto& remote = owner->remote[k];
+        b->next = remote.load(std::memory_order_relaxed);
+        while (!remote.compare_exchange_weak(b->next, b,
+                                             std::memory_order_release,
+                                             std::memory_order_relaxed)) {}
+    }
+}
+
+
+void NodePool::trim() noexcept {
+    if (!current) { return; }
+    for (std::size_t k = 0; k < classes; ++k) {
+        for (auto b = reclaim(*current, k); b;) {
+            release(std::exchange(b, b->next));
+        }
+    }
+    drain(*current);
+}
+
+
+std::size_t NodePool::cached() noexcept {
+    if (!current) { return 0; }
+    std::size_t ret = 0;
+    for (auto const n: current->count) { ret += n; }
+    return ret;
+}
+
+
+}
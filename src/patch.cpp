@@ -0,0 +1,472 @@
+/*
+  MIT License
+
+  Copyright (c) 2018 Nicolai Trandafil
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+// ifce
+#include <serialize/patch.hpp>
+
+// local
+#include <serialize/path.hpp>
+
+// std
+#include <cstdint>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+
+
+namespace serialize {
+
+
+namespace {
+
+
+/// Hashes of every subtree of both inputs, computed up front without
+/// modifying them, the comparisons of the subtrees then only visit the
+/// values when their hashes are equal
+class Hashes {
+public:
+    Hashes(Variant const& a, Variant const& b) {
+        auto const add = [this](Variant const& x, std::uint64_t hash) {
+            hashes.emplace(&x, hash);
+        };
+        a.hashEach(add);
+        b.hashEach(add);
+    }
+
+    bool equal(Variant const& a, Variant const& b) const {
+        return &a == &b || (hashes.at(&a) == hashes.at(&b) && a == b);
+    }
+
+private:
+    std::unordered_map<Variant const*, std::uint64_t> hashes;
+};
+
+
+void appendKey(std::string& path, std::string const& key) {
+    path += '/';
+    for (auto const c: key) {
+        if (c == '~') {
+            path += "~0";
+        } else if (c == '/') {
+            path += "~1";
+        } else {
+            path += c;
+        }
+    }
+}
+
+
+class Differ {
+public:
+    Differ(Variant const& a, Variant const& b) : hashes(a, b) {}
+
+    void run(Variant const& a, Variant const& b) {
+        if (hashes.equal(a, b)) { return; }
+
+        if (a.is<Variant::Map>() && b.is<Variant::Map>()) {
+            maps(a.map(), b.map());
+        } else if (a.is<Variant::Vec>() && b.is<Variant::Vec>()) {
+            vecs(a.vec(), b.vec());
+        } else {
+            op("replace", &b);
+        }
+    }
+
+    Variant::Vec ops;
+
+private:
+    void maps(Variant::Map const& a, Variant::Map const& b) {
+        auto const size = path.size();
+        for (auto it = a.begin(); it != a.end(); ++it) {
+            if (!b.contains(a.key(it))) {
+                appendKey(path, it->first);
+                op("remove", nullptr);
+                path.resize(size);
+            }
+        }
+
+        for (auto it = b.begin(); it != b.end(); ++it) {
+            appendKey(path, it->first);
+            auto const x = a.find(b.key(it));
+            if (x == a.end()) {
+                op("add", &it->second);
+            } else {
+                run(x->second, it->second);
+            }
+            path.resize(size);
+        }
+    }
+
+    void vecs(Variant::Vec const& a, Variant::Vec const& b) {
+        std::size_t prefix = 0;
+        while (prefix < a.size() && prefix < b.size() &&
+               hashes.equal(a[prefix], b[prefix])) {
+            ++prefix;
+        }
+
+        std::size_t suffix = 0;
+        while (suffix < a.size() - prefix && suffix < b.size() - prefix &&
+               hashes.equal(a[a.size() - 1 - suffix], b[b.size() - 1 - suffix])) {
+            ++suffix;
+        }
+
+        auto const na = a.size() - prefix - suffix;
+        auto const nb = b.size() - prefix - suffix;
+        auto const common = std::min(na, nb);
+        auto const size = path.size();
+
+        for (std::size_t i = 0; i < common; ++i) {
+            appendKey(path, std::to_string(prefix + i));
+            run(a[prefix + i], b[prefix + i]);
+            path.resize(size);
+        }
+
+        for (std::size_t i = common; i < nb; ++i) {
+            appendKey(path, std::to_string(prefix + i));
+            op("add", &b[prefix + i]);
+            path.resize(size);
+        }
+
+        for (std::size_t i = na; i > common; --i) {
+            appendKey(path, std::to_string(prefix + i - 1));
+            op("remove", nullptr);
+            path.resize(size);
+        }
+    }
+
+    void op(char const* name, Variant const* value) {
+        Variant::Map ret;
+        ret.reserve(3);
+        ret.emplace("op", Variant(name));
+        ret.emplace("path", Variant(path));
+        if (value) { ret.emplace("value", *value); }
+        ops.emplace_back(std::move(ret));
+    }
+
+    Hashes hashes;
+    std::string path;
+};
+
+
+Variant mergeDiffImpl(Variant const& a, Variant const& b, Hashes const& hashes) {
+    if (!a.is<Variant::Map>() || !b.is<Variant::Map>()) { return b; }
+
+    auto const& am = a.map();
+    auto const& bm = b.map();
+    Variant::Map ret;
+
+    for (auto it = am.begin(); it != am.end(); ++it) {
+        if (!bm.contains(am.key(it))) { ret.emplace(it->first, Variant()); }
+    }
+
+    for (auto it = bm.begin(); it != bm.end(); ++it) {
+        auto const x = am.find(bm.key(it));
+        if (x == am.end()) {
+            ret.emplace(it->first, it->second);
+        } else if (!hashes.equal(x->second, it->second)) {
+            ret.emplace(it->first, mergeDiffImpl(x->second, it->second, hashes));
+        }
+    }
+
+    return Variant(std::move(ret));
+}
+
+
+/// The map of `x`, modifiable when `x` is, to move out of it
+template <typename V>
+auto& mapOf(V& x) {
+    if constexpr (std::is_const_v<V>) {
+        return x.map();
+    } else {
+        return x.mapMut();
+    }
+}
+
+
+template <typename V>
+auto& vecOf(V& x) {
+    if constexpr (std::is_const_v<V>) {
+        return x.vec();
+    } else {
+        return x.vecMut();
+    }
+}
+
+
+/// `x` as an rvalue when it is modifiable
+template <typename V>
+decltype(auto) take(V& x) {
+    if constexpr (std::is_const_v<V>) {
+        return x;
+    } else {
+        return std::move(x);
+    }
+}
+
+
+Variant* child(Variant& x, Path::Step const& step) {
+    if (x.is<Variant::Map>()) {
+        auto& map = x.mapMut();
+        auto const it = map.find(step.prehashed());
+        return it == map.end() ? nullptr : &it->second;
+    }
+
+    if (x.is<Variant::Vec>()) {
+        auto& vec = x.vecMut();
+        return step.index < vec.size() ? &vec[step.index] : nullptr;
+    }
+
+    return nullptr;
+}
+
+
+/// The value at the first `n` steps of `path`
+Variant* resolve(Variant& x, Path const& path, std::size_t n) {
+    auto ret = &x;
+    for (std::size_t i = 0; ret && i < n; ++i) {
+        ret = child(*ret, path.steps()[i]);
+    }
+    return ret;
+}
+
+
+Variant& existing(Variant& x, Path const& path) {
+    if (auto const ret = resolve(x, path, path.steps().size())) { return *ret; }
+    throw PatchError("no value at '" + path.str() + "'");
+}
+
+
+Variant& parentOf(Variant& x, Path const& path) {
+    if (auto const ret = resolve(x, path, path.steps().size() - 1)) {
+        return *ret;
+    }
+    throw PatchError("no parent of '" + path.str() + "'");
+}
+
+
+void add(Variant& x, Path const& path, Variant value) {
+    if (path.empty()) {
+        x = std::move(value);
+        return;
+    }
+
+    auto& parent = parentOf(x, path);
+    auto const& step = path.steps().back();
+
+    if (parent.is<Variant::Map>()) {
+        parent.mapMut().insert_or_assign(step.prehashed(), std::move(value));
+    } else if (parent.is<Variant::Vec>()) {
+        auto& vec = parent.vecMut();
+        if (step.key == "-") {
+            vec.push_back(std::move(value));
+        } else if (step.index <= vec.size()) {
+            vec.insert(vec.begin() + std::ptrdiff_t(step.index), std::move(value));
+        } else {
+            throw PatchError("bad index at '" + path.str() + "'");
+        }
+    } else {
+        throw PatchError("no container at '" + path.str() + "'");
+    }
+}
+
+
+Variant remove(Variant& x, Path const& path) {
+    if (path.empty()) { throw PatchError("can not remove the root"); }
+
+    auto& parent = parentOf(x, path);
+    auto const& step = path.steps().back();
+
+    if (parent.is<Variant::Map>()) {
+        auto& map = parent.mapMut();
+        auto const it = map.find(step.prehashed());
+        if (it != map.end()) {
+            auto ret = std::move(it->second);
+            map.erase(it);
+            return ret;
+        }
+    } else if (parent.is<Variant::Vec>()) {
+        auto& vec = parent.vecMut();
+        if (step.index < vec.size()) {
+            auto ret = std::move(vec[step.index]);
+            vec.erase(vec.begin() + std::ptrdiff_t(step.index));
+            return ret;
+        }
+    }
+
+    throw PatchError("no value at '" + path.str() + "'");
+}
+
+
+bool isProperPrefix(Path const& a, Path const& b) {
+    auto const& x = a.steps();
+    auto const& y = b.steps();
+    if (x.size() >= y.size()) { return false; }
+    for (std::size_t i = 0; i < x.size(); ++i) {
+        if (x[i].key != y[i].key) { return false; }
+    }
+    return true;
+}
+
+
+template <typename V>
+V& member(V& op, char const* name) {
+    auto& map = mapOf(op);
+    auto const it = map.find(name);
+    if (it == map.end()) {
+        throw PatchError(std::string("operation without '") + name + "'");
+    }
+    return it->second;
+}
+
+
+template <typename V>
+void applyPatchImpl(Variant& x, V& patch) {
+    if (!patch.template is<Variant::Vec>()) {
+        throw PatchError("a JSON Patch is a vector of operations");
+    }
+
+    for (auto& op: vecOf(patch)) {
+        if (!op.template is<Variant::Map>()) {
+            throw PatchError("operation is not a map");
+        }
+
+        auto const& name = member(op, "op").str();
+        auto const path = Path::pointer(member(op, "path").str());
+
+        if (name == "add") {
+            add(x, path, take(member(op, "value")));
+        } else if (name == "remove") {
+            remove(x, path);
+        } else if (name == "replace") {
+            existing(x, path) = take(member(op, "value"));
+        } else if (name == "move") {
+            auto const from = Path::pointer(member(op, "from").str());
+            if (isProperPrefix(from, path)) {
+                throw PatchError("can not move '" + from.str() +
+                                 "' into itself");
+            }
+            if (!(from == path)) { add(x, path, remove(x, from)); }
+        } else if (name == "copy") {
+            auto const from = Path::pointer(member(op, "from").str());
+            add(x, path, existing(x, from));
+        } else if (name == "test") {
+            auto const actual = resolve(x, path, path.steps().size());
+            if (!actual || !(*actual == member(op, "value"))) {
+                throw PatchError("test failed at '" + path.str() + "'");
+            }
+        } else {
+            throw PatchError("unknown operation '" + name + "'");
+        }
+    }
+}
+
+
+template <typename V>
+void mergeImpl(Variant& x, V& overlay, MergePolicy const& policy) {
+    if (overlay.empty()) {
+        if (policy.nulls == MergePolicy::Nulls::skip) { return; }
+        x = take(overlay);
+        return;
+    }
+
+    if (overlay.template is<Variant::Vec>() && x.is<Variant::Vec>()
+            && policy.arrays == MergePolicy::Arrays::concat) {
+        auto& target = x.vecMut();
+        auto& vec = vecOf(overlay);
+        target.reserve(target.size() + vec.size());
+        for (auto& y: vec) { target.push_back(take(y)); }
+        return;
+    }
+
+    if (!overlay.template is<Variant::Map>()) {
+        x = take(overlay);
+        return;
+    }
+
+    if (!x.is<Variant::Map>()) { x = Variant(Variant::Map()); }
+
+    auto& target = x.mapMut();
+    auto& map = mapOf(overlay);
+    for (auto it = map.begin(); it != map.end(); ++it) {
+        if (it->second.empty()) {
+            switch (policy.nulls) {
+            case MergePolicy::Nulls::remove:
+                target.erase(map.key(it));
+                break;
+            case MergePolicy::Nulls::assign:
+                target[map.key(it)] = Variant();
+                break;
+            case MergePolicy::Nulls::skip:
+                break;
+            }
+        } else {
+            mergeImpl(target[map.key(it)], it->second, policy);
+        }
+    }
+}
+
+
+} // namespace
+
+
+Variant diff(Variant const& a, Variant const& b) {
+    Differ differ(a, b);
+    differ.run(a, b);
+    return Variant(std::move(differ.ops));
+}
+
+
+Variant mergeDiff(Variant const& a, Variant const& b) {
+    return mergeDiffImpl(a, b, Hashes(a, b));
+}
+
+
+void applyPatch(Variant& x, Variant const& patch) { applyPatchImpl(x, patch); }
+
+
+void applyPatch(Variant& x, Variant&& patch) { applyPatchImpl(x, patch); }
+
+
+void applyMergePatch(Variant& x, Variant const& patch) {
+    mergeImpl(x, patch, MergePolicy());
+}
+
+
+void applyMergePatch(Variant& x, Variant&& patch) {
+    mergeImpl(x, patch, MergePolicy());
+}
+
+
+void merge(Variant& base, Variant const& overlay, MergePolicy const& policy) {
+    mergeImpl(base, overlay, policy);
+}
+
+
+void merge(Variant& base, Variant&& overlay, MergePolicy const& policy) {
+    mergeImpl(base, overlay, policy);
+}
+
+
+}
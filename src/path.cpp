@@ -0,0 +1,239 @@
+/*
+  MIT License
+
+  Copyright (c) 2018 Nicolai Trandafil
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+// ifce
+#include <serialize/path.hpp>
+
+// local
+#include <serialize/algorithm/hash.hpp>
+
+// std
+#include <utility>
+
+
+namespace serialize {
+
+
+namespace {
+
+
+std::size_t parseIndex(std::string_view x) noexcept {
+    if (x.empty() || (x.size() > 1 && x.front() == '0')) { return Path::no_index; }
+
+    std::size_t ret = 0;
+    for (auto const c: x) {
+        if (c < '0' || c > '9') { return Path::no_index; }
+        auto const digit = static_cast<std::size_t>(c - '0');
+        if (ret > (Path::no_index - 1 - digit) / 10) { return Path::no_index; }
+        ret = ret * 10 + digit;
+    }
+    return ret;
+}
+
+
+Path::Step makeStep(std::string key) {
+    Path::Step ret;
+    ret.hash = fnv1a(key);
+    ret.index = parseIndex(key);
+    ret.key = std::move(key);
+    return ret;
+}
+
+
+} // namespace
+
+
+Path Path::pointer(std::string_view x) {
+    Path ret;
+    if (x.empty()) { return ret; }
+    if (x.front() != '/') {
+        throw PathError("JSON Pointer must start with '/': " + std::string(x));
+    }
+
+    std::string key;
+    for (std::size_t i = 1; i <= x.size(); ++i) {
+        if (i == x.size() || x[i] == '/') {
+            ret.push(std::move(key));
+            key.clear();
+        } else if (x[i] == '~') {
+            auto const next = i + 1 < x.size() ? x[++i] : '\0';
+            if (next == '0') {
+                key += '~';
+            } else if (next == '1') {
+                key += '/';
+            } else {
+                throw PathError("bad escape in JSON Pointer: " + std::string(x));
+            }
+        } else {
+            key += x[i];
+        }
+    }
+    return ret;
+}
+
+
+Path Path::dotted(std::string_view x) {
+    Path ret;
+    std::size_t i = 0;
+    bool expect_key = x.empty() || x.front() != '[';
+
+    while (i < x.size()) {
+        if (x[i] == '[') {
+            auto const end = x.find(']', i);
+            auto const token = x.substr(i + 1, end == x.npos ? end : end - i - 1);
+            if (end == x.npos || parseIndex(token) == no_index) {
+                throw PathError("bad index in " + std::string(x));
+            }
+            ret.push(std::string(token));
+            i = end + 1;
+            expect_key = false;
+        } else if (x[i] == '.' && !expect_key) {
+            ++i;
+            expect_key = true;
+        } else if (expect_key) {
+            auto const end = x.find_first_of(".[", i);
+            auto const token = x.substr(i, end == x.npos ? end : end - i);
+            if (token.empty()) {
+                throw PathError("empty key in " + std::string(x));
+            }
+            ret.push(std::string(token));
+            i = end == x.npos ? x.size() : end;
+            expect_key = false;
+        } else {
+            throw PathError("unexpected '" + std::string(1, x[i]) + "' in " +
+                            std::string(x));
+        }
+    }
+
+    if (expect_key && !x.empty()) {
+        throw PathError("empty key in " + std::string(x));
+    }
+    return ret;
+}
+
+
+Path& Path::push(std::string key) {
+    m.push_back(makeStep(std::move(key)));
+    return *this;
+}
+
+
+std::string Path::str() const {
+    std::string ret;
+    for (auto const& x: m) {
+        ret += '/';
+        for (auto const c: x.key) {
+            if (c == '~') {
+                ret += "~0";
+            } else if (c == '/') {
+                ret += "~1";
+            } else {
+                ret += c;
+            }
+        }
+    }
+    return ret;
+}
+
+
+Variant const* Path::child(Variant const& x, Step const& step) noexcept {
+    if (x.is<Variant::Map>()) {
+        auto const& map = x.map();
+        auto const it = map.find(step.prehashed());
+        return it == map.end() ? nullptr : &it->second;
+    }
+
+    if (x.is<Variant::Vec>()) {
+        auto const& vec = x.vec();
+        return step.index < vec.size() ? &vec[step.index] : nullptr;
+    }
+
+    return nullptr;
+}
+
+
+bool Path::operator==(Path const& rhs) const noexcept {
+    if (m.size() != rhs.m.size()) { return false; }
+    for (std::size_t i = 0; i < m.size(); ++i) {
+        if (m[i].key != rhs.m[i].key) { return false; }
+    }
+    return true;
+}
+
+
+PathSet::PathSet(std::vector<Path> const& paths)
+    : nodes(1)
+    , count(paths.size())
+{
+    for (std::size_t i = 0; i < paths.size(); ++i) {
+        std::size_t node = 0;
+        for (auto const& step: paths[i].steps()) {
+            std::size_t next = 0;
+            for (auto const child: nodes[node].children) {
+                auto const& x = nodes[child].step;
+                if (x.hash == step.hash && x.key == step.key) {
+                    next = child;
+                    break;
+                }
+            }
+
+            if (next == 0) {
+                next = nodes.size();
+                nodes.push_back({step, {}, {}});
+                nodes[node].children.push_back(next);
+            }
+            node = next;
+        }
+        nodes[node].ends.push_back(i);
+    }
+}
+
+
+std::vector<Variant const*> PathSet::extract(Variant const& x) const {
+    std::vector<Variant const*> ret;
+    extract(x, ret);
+    return ret;
+}
+
+
+void PathSet::extract(Variant const& x, std::vector<Variant const*>& out) const {
+    out.assign(count, nullptr);
+    walk(0, &x, out);
+}
+
+
+void PathSet::walk(std::size_t node, Variant const* x,
+                   std::vector<Variant const*>& out) const {
+    if (!x) { return; }
+
+    auto const& n = nodes[node];
+    for (auto const i: n.ends) { out[i] = x; }
+    for (auto const child: n.children) {
+        walk(child, Path::child(*x, nodes[child].step), out);
+    }
+}
+
+
+}
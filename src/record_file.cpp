@@ -0,0 +1,474 @@
+/*
+  MIT License
+
+  Copyright (c) 2018 Nicolai Trandafil
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+// ifce
+#include <serialize/record_file.hpp>
+
+// local
+#include <serialize/binary.hpp>
+
+// 3rd
+#ifndef SERIALIZE_ENABLE_LZ4
+#define SERIALIZE_ENABLE_LZ4 0
+#endif
+
+#ifndef SERIALIZE_ENABLE_ZSTD
+#define SERIALIZE_ENABLE_ZSTD 0
+#endif
+
+#if SERIALIZE_ENABLE_LZ4
+#include <lz4.h>
+#endif
+
+#if SERIALIZE_ENABLE_ZSTD
+#include <zstd.h>
+#endif
+
+// sys
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// std
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <exception>
+#include <limits>
+#include <mutex>
+
+
+namespace serialize {
+
+
+namespace {
+
+
+constexpr std::string_view file_magic = "SREC";
+constexpr std::string_view index_magic = "SRIX";
+constexpr std::uint8_t version = 1;
+
+constexpr std::size_t header_size = 5;
+constexpr std::size_t block_header_size = 13;
+constexpr std::size_t entry_size = 20;
+constexpr std::size_t trailer_size = 20;
+
+/// Most bytes an LZ4 sequence byte expands to, a match length byte adds 255
+constexpr std::uint64_t lz4_max_ratio = 255;
+
+/// Most bytes a zstd byte expands to, a 4 bytes RLE block holds 128KiB
+constexpr std::uint64_t zstd_max_ratio = 32768;
+
+
+std::string errnoMessage(std::string const& what) {
+    return what + ": " + std::strerror(errno);
+}
+
+
+void compress(Codec codec, [[maybe_unused]] int level, std::string const& src, std::string& dst) {
+    switch (codec) {
+    case Codec::none:
+        dst = src;
+        return;
+
+    case Codec::lz4:
+#if SERIALIZE_ENABLE_LZ4
+    {
+        if (src.size() > static_cast<std::size_t>(LZ4_MAX_INPUT_SIZE)) {
+            throw RecordFileError("block is too large for LZ4");
+        }
+        auto const n = static_cast<int>(src.size());
+        dst.resize(static_cast<std::size_t>(LZ4_compressBound(n)));
+        auto const ret = LZ4_compress_fast(
+            src.data(), dst.data(), n, static_cast<int>(dst.size()),
+            level > 0 ? level : 1);
+        if (ret <= 0) { throw RecordFileError("LZ4 compression failed"); }
+        dst.resize(static_cast<std::size_t>(ret));
+        return;
+    }
+#else
+        break;
+#endif
+
+    case Codec::zstd:
+#if SERIALIZE_ENABLE_ZSTD
+    {
+        dst.resize(ZSTD_compressBound(src.size()));
+        auto const ret = ZSTD_compress(dst.data(), dst.size(),
+                                       src.data(), src.size(), level);
+        if (ZSTD_isError(ret)) {
+            throw RecordFileError(ZSTD_getErrorName(ret));
+        }
+        dst.resize(ret);
+        return;
+    }
+#else
+        break;
+#endif
+    }
+
+    throw RecordFileError("codec is not supported");
+}
+
+
+void decompress(Codec codec, std::string_view src, std::string& dst) {
+    switch (codec) {
+    case Codec::none:
+        if (src.size() != dst.size()) {
+            throw RecordFileError("block size mismatch");
+        }
+        std::memcpy(dst.data(), src.data(), src.size());
+        return;
+
+    case Codec::lz4:
+#if SERIALIZE_ENABLE_LZ4
+    {
+        auto const ret = LZ4_decompress_safe(
+            src.data(), dst.data(),
+            static_cast<int>(src.size()), static_cast<int>(dst.size()));
+        if (ret < 0 || static_cast<std::size_t>(ret) != dst.size()) {
+            throw RecordFileError("corrupted LZ4 block");
+        }
+        return;
+    }
+#else
+        break;
+#endif
+
+    case Codec::zstd:
+#if SERIALIZE_ENABLE_ZSTD
+    {
+        auto const ret = ZSTD_decompress(dst.data(), dst.size(),
+                                         src.data(), src.size());
+        if (ZSTD_isError(ret) || ret != dst.size()) {
+            throw RecordFileError("corrupted zstd block");
+        }
+        return;
+    }
+#else
+        break;
+#endif
+    }
+
+    throw RecordFileError("codec is not supported");
+}
+
+
+/// Bound of the raw size of a block stored in `stored` bytes, larger sizes
+/// are corrupted and must not be allocated
+std::uint64_t maxRawSize(Codec codec, std::uint64_t stored) noexcept {
+    switch (codec) {
+    case Codec::none: return stored;
+    case Codec::lz4: return stored * lz4_max_ratio;
+    case Codec::zstd: return stored * zstd_max_ratio;
+    }
+    return 0;
+}
+
+
+} // namespace
+
+
+bool codecSupported(Codec codec) noexcept {
+    switch (codec) {
+    case Codec::none: return true;
+    case Codec::lz4: return SERIALIZE_ENABLE_LZ4;
+    case Codec::zstd: return SERIALIZE_ENABLE_ZSTD;
+    }
+    return false;
+}
+
+
+RecordWriter::RecordWriter(std::string const& path,
+                           RecordWriterOptions const& options)
+    : options(options)
+{
+    if (!codecSupported(options.codec)) {
+        throw RecordFileError("codec is not supported");
+    }
+
+    fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) { throw RecordFileError(errnoMessage(path)); }
+
+    std::string header(file_magic);
+    header.push_back(static_cast<char>(version));
+    write(header);
+}
+
+
+RecordWriter::~RecordWriter() {
+    try {
+        close();
+    } catch (...) {
+    }
+}
+
+
+void RecordWriter::append(std::string_view record) {
+    binary::putVarint(block, record.size());
+    block.append(record.data(), record.size());
+    ++pending;
+    if (block.size() >= options.block_size) { flush(); }
+}
+
+
+void RecordWriter::flush() {
+    if (pending == 0) { return; }
+    if (block.size() > std::numeric_limits<std::uint32_t>::max()) {
+        throw RecordFileError("block exceeds 4GiB");
+    }
+
+    compress(options.codec, options.level, block, compressed);
+
+    std::string header;
+    header.push_back(static_cast<char>(options.codec));
+    binary::putFixed(header, pending, 4);
+    binary::putFixed(header, block.size(), 4);
+    binary::putFixed(header, compressed.size(), 4);
+
+    index.push_back(Entry{offset, records, pending});
+    write(header);
+    write(compressed);
+
+    records += pending;
+    pending = 0;
+    block.clear();
+}
+
+
+void RecordWriter::close() {
+    if (fd < 0) { return; }
+
+    flush();
+
+    std::string tail;
+    for (auto const& x: index) {
+        binary::putFixed(tail, x.offset, 8);
+        binary::putFixed(tail, x.first, 8);
+        binary::putFixed(tail, x.count, 4);
+    }
+    binary::putFixed(tail, offset, 8);
+    binary::putFixed(tail, index.size(), 8);
+    tail += index_magic;
+    write(tail);
+
+    auto const ret = ::close(fd);
+    fd = -1;
+    if (ret != 0) { throw RecordFileError(errnoMessage("close")); }
+}
+
+
+void RecordWriter::write(std::string_view x) {
+    while (!x.empty()) {
+        auto const ret = ::write(fd, x.data(), x.size());
+        if (ret < 0) {
+            if (errno == EINTR) { continue; }
+            throw RecordFileError(errnoMessage("write"));
+        }
+        x.remove_prefix(static_cast<std::size_t>(ret));
+        offset += static_cast<std::size_t>(ret);
+    }
+}
+
+
+RecordReader::RecordReader(std::string const& path) {
+    fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) { throw RecordFileError(errnoMessage(path)); }
+
+    try {
+        struct stat st;
+        if (::fstat(fd, &st) != 0) { throw RecordFileError(errnoMessage(path)); }
+        auto const size = static_cast<std::uint64_t>(st.st_size);
+
+        if (size < header_size + trailer_size) {
+            throw RecordFileError("file is too short");
+        }
+
+        auto const header = read(0, header_size);
+        if (header.substr(0, 4) != file_magic ||
+                static_cast<std::uint8_t>(header[4]) != version) {
+            throw RecordFileError("not a record file");
+        }
+
+        auto const trailer = read(size - trailer_size, trailer_size);
+        binary::Input tin(trailer);
+        auto const index_offset = tin.fixed(8);
+        auto const count = tin.fixed(8);
+        if (tin.bytes(4) != index_magic) {
+            throw RecordFileError("missing block index");
+        }
+        if (index_offset > size - trailer_size ||
+                count != (size - trailer_size - index_offset) / entry_size) {
+            throw RecordFileError("corrupted block index");
+        }
+
+        auto const raw = read(index_offset, static_cast<std::size_t>(count) * entry_size);
+        binary::Input in(raw);
+        index.reserve(static_cast<std::size_t>(count));
+        // blocks follow each other up to the index
+        std::uint64_t next = header_size;
+        for (std::uint64_t i = 0; i < count; ++i) {
+            Entry x;
+            x.offset = in.fixed(8);
+            x.first = in.fixed(8);
+            x.count = static_cast<std::uint32_t>(in.fixed(4));
+            if (x.first != records || x.offset < next ||
+                    x.offset > index_offset ||
+                    index_offset - x.offset < block_header_size) {
+                throw RecordFileError("corrupted block index");
+            }
+            next = x.offset + block_header_size;
+            records += x.count;
+            index.push_back(x);
+        }
+        blocks_end = index_offset;
+    } catch (...) {
+        ::close(fd);
+        throw;
+    }
+}
+
+
+RecordReader::~RecordReader() {
+    ::close(fd);
+}
+
+
+std::size_t RecordReader::blockOf(std::uint64_t record) const {
+    if (record >= records) {
+        throw std::out_of_range("record number is out of range");
+    }
+    auto const it = std::upper_bound(
+        index.begin(), index.end(), record,
+        [](std::uint64_t x, Entry const& e) { return x < e.first; });
+    return static_cast<std::size_t>(std::prev(it) - index.begin());
+}
+
+
+RecordBlock RecordReader::block(std::size_t i) const {
+    auto const& entry = index.at(i);
+
+    auto const header = read(entry.offset, block_header_size);
+    binary::Input hin(header);
+    auto const codec = static_cast<Codec>(hin.bytes(1)[0]);
+    auto const count = hin.fixed(4);
+    auto const raw_size = hin.fixed(4);
+    auto const stored_size = hin.fixed(4);
+    if (!codecSupported(codec)) {
+        throw RecordFileError("codec is not supported");
+    }
+
+    // the sizes are checked before allocating: the payload fills the space
+    // up to the next block, the codec bounds its expansion and every record
+    // takes a byte at least
+    auto const end = i + 1 < index.size() ? index[i + 1].offset : blocks_end;
+    if (count != entry.count ||
+            stored_size != end - entry.offset - block_header_size ||
+            raw_size > maxRawSize(codec, stored_size) ||
+            count > raw_size) {
+        throw RecordFileError("corrupted block");
+    }
+
+    auto const stored = read(entry.offset + block_header_size,
+                             static_cast<std::size_t>(stored_size));
+
+    RecordBlock ret;
+    ret.first_ = entry.first;
+    ret.data.resize(static_cast<std::size_t>(raw_size));
+    decompress(codec, stored, ret.data);
+
+    try {
+        binary::Input in(ret.data);
+        ret.spans.reserve(static_cast<std::size_t>(count));
+        for (std::uint64_t j = 0; j < count; ++j) {
+            auto const n = in.size();
+            auto const at = ret.data.size() - in.left();
+            in.bytes(n);
+            ret.spans.emplace_back(at, n);
+        }
+        if (in.left() != 0) { throw RecordFileError("corrupted block"); }
+    } catch (BinaryError const& e) {
+        throw RecordFileError(std::string("corrupted block: ") + e.what());
+    }
+
+    return ret;
+}
+
+
+std::vector<RecordBlock> RecordReader::blocks(std::size_t first,
+                                              std::size_t last,
+                                              unsigned threads) const {
+    last = std::min(last, index.size());
+    if (first >= last) { return {}; }
+
+    std::vector<RecordBlock> ret(last - first);
+    if (threads == 0) { threads = std::thread::hardware_concurrency(); }
+    threads = static_cast<unsigned>(std::min<std::size_t>(
+        std::max(threads, 1u), ret.size()));
+
+    std::atomic<std::size_t> next{first};
+    std::exception_ptr error;
+    std::mutex error_mutex;
+
+    auto const work = [&] {
+        for (auto i = next++; i < last; i = next++) {
+            try {
+                ret[i - first] = block(i);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (!error) { error = std::current_exception(); }
+            }
+        }
+    };
+
+    std::vector<std::thread> pool;
+    pool.reserve(threads - 1);
+    for (unsigned t = 1; t < threads; ++t) { pool.emplace_back(work); }
+    work();
+    for (auto& t: pool) { t.join(); }
+
+    if (error) { std::rethrow_exception(error); }
+    return ret;
+}
+
+
+std::string RecordReader::read(std::uint64_t offset, std::size_t size) const {
+    std::string ret(size, '\0');
+    std::size_t done = 0;
+    while (done < size) {
+        auto const n = ::pread(fd, ret.data() + done, size - done,
+                               static_cast<off_t>(offset + done));
+        if (n < 0) {
+            if (errno == EINTR) { continue; }
+            throw RecordFileError(errnoMessage("read"));
+        }
+        if (n == 0) { throw RecordFileError("unexpected end of file"); }
+        done += static_cast<std::size_t>(n);
+    }
+    return ret;
+}
+
+
+}
@@ -0,0 +1,239 @@
+/*
+  MIT License
+
+  Copyright (c) 2018 Nicolai Trandafil
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+// ifce
+#include <serialize/snapshot.hpp>
+
+// sys
+#ifdef __linux__
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+// std
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+
+namespace serialize {
+
+
+namespace detail {
+
+
+namespace {
+
+
+/// Epoch slot of a thread, taken over by a later thread once it exits
+struct Record {
+    /// Epoch the thread is pinned since, 0 when it is not
+    std::atomic<std::uint64_t> epoch{0};
+
+    std::atomic<bool> used{true};
+
+    /// Nesting of the pins, touched by the owning thread only
+    unsigned depth{0};
+
+    Record* next{nullptr};
+};
+
+
+std::atomic<std::uint64_t> global_epoch{1};
+
+
+/// Never freed, there are as many as threads ever pinned at once
+std::atomic<Record*> records{nullptr};
+
+
+Record* acquire() {
+    for (auto x = records.load(std::memory_order_acquire); x; x = x->next) {
+        bool expected = false;
+        if (!x->used.load(std::memory_order_relaxed) &&
+                x->used.compare_exchange_strong(expected, true,
+                                                std::memory_order_acquire)) {
+            return x;
+        }
+    }
+
+    auto const x = new Record;
+    x->next = records.load(std::memory_order_relaxed);
+    while (!records.compare_exchange_weak(x->next, x,
+                                          std::memory_order_release,
+                                          std::memory_order_relaxed)) {}
+    return x;
+}
+
+
+/// Releases the record of the thread when it exits
+struct Owner {
+    ~Owner() {
+        if (record) { record->used.store(false, std::memory_order_release); }
+    }
+
+    Record* record{nullptr};
+};
+
+
+thread_local Owner owner;
+
+
+std::string errnoMessage(std::string const& what) {
+    return what + ": " + std::strerror(errno);
+}
+
+
+} // namespace
+
+
+void Epoch::pin() {
+    if (!owner.record) { owner.record = acquire(); }
+    auto& x = *owner.record;
+    if (x.depth++ == 0) {
+        x.epoch.store(global_epoch.load(std::memory_order_seq_cst),
+                      std::memory_order_seq_cst);
+    }
+}
+
+
+void Epoch::unpin() noexcept {
+    auto& x = *owner.record;
+    if (--x.depth == 0) { x.epoch.store(0, std::memory_order_release); }
+}
+
+
+std::uint64_t Epoch::advance() noexcept {
+    return global_epoch.fetch_add(1, std::memory_order_seq_cst) + 1;
+}
+
+
+/// A thread pinned at `epoch` or later loaded the pointer after the swap
+/// which preceded the start of `epoch`
+bool Epoch::quiescent(std::uint64_t epoch) noexcept {
+    for (auto x = records.load(std::memory_order_acquire); x; x = x->next) {
+        auto const pinned = x->epoch.load(std::memory_order_seq_cst);
+        if (pinned != 0 && pinned < epoch) { return false; }
+    }
+    return true;
+}
+
+
+#ifdef __linux__
+
+
+/// The directory is watched, editors often replace the file by a rename
+FileWatcher::FileWatcher(std::string const& path, std::function<void()> changed)
+    : changed(std::move(changed))
+{
+    auto const slash = path.find_last_of('/');
+    auto const dir = slash == std::string::npos ? std::string(".")
+                   : slash == 0                 ? std::string("/")
+                                                : path.substr(0, slash);
+    auto const name = slash == std::string::npos ? path : path.substr(slash + 1);
+
+    fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) { throw SnapshotError(errnoMessage("inotify")); }
+
+    if (inotify_add_watch(fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0 ||
+            pipe2(stop, O_CLOEXEC) != 0) {
+        SnapshotError const error(errnoMessage(dir));
+        close(fd);
+        throw error;
+    }
+
+    thread = std::thread([this, name] { run(name); });
+}
+
+
+FileWatcher::~FileWatcher() {
+    char const c = 0;
+    if (write(stop[1], &c, 1) == 1) { thread.join(); }
+    close(stop[0]);
+    close(stop[1]);
+    close(fd);
+}
+
+
+void FileWatcher::run(std::string const& name) {
+    alignas(inotify_event) char buffer[4096];
+    pollfd fds[2] = {{fd, POLLIN, 0}, {stop[0], POLLIN, 0}};
+
+    for (;;) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) { continue; }
+            return;
+        }
+        if (fds[1].revents != 0) { return; }
+
+        // a burst of events makes one call
+        bool hit = false;
+        for (;;) {
+            auto const n = read(fd, buffer, sizeof(buffer));
+            if (n <= 0) { break; }
+            for (auto p = buffer; p < buffer + n;) {
+                auto const event = reinterpret_cast<inotify_event const*>(p);
+                if (event->len != 0 && name == event->name) { hit = true; }
+                p += sizeof(inotify_event) + event->len;
+            }
+        }
+        if (hit) { changed(); }
+    }
+}
+
+
+#else
+
+
+FileWatcher::FileWatcher(std::string const&, std::function<void()>) {
+    throw SnapshotError("file watching is not supported on this platform");
+}
+
+
+FileWatcher::~FileWatcher() = default;
+
+
+void FileWatcher::run(std::string const&) {}
+
+
+#endif
+
+
+std::string readFile(std::string const& path) {
+    std::ifstream in(path, std::ios::binary);
+    std::ostringstream ret;
+    if (!in || !(ret << in.rdbuf())) {
+        throw SnapshotError("can not read " + path);
+    }
+    return ret.str();
+}
+
+
+} // namespace detail
+
+
+}
@@ -0,0 +1,94 @@
+/*
+  MIT License
+
+  Copyright (c) 2018 Nicolai Trandafil
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+// ifce
+#include <serialize/validate.hpp>
+
+// std
+#include <string>
+#include <vector>
+
+
+namespace serialize {
+
+
+char const* describe(ValidationErrc x) noexcept {
+    switch (x) {
+    case ValidationErrc::missing: return "missing";
+    case ValidationErrc::empty: return "empty";
+    case ValidationErrc::bad_type: return "wrong type";
+    case ValidationErrc::overflow: return "out of range";
+    case ValidationErrc::unknown_tag: return "unknown tag";
+    case ValidationErrc::parse: return "malformed input";
+    }
+    return "unknown";
+}
+
+
+std::string ValidationError::path() const {
+    std::string ret;
+    for (auto const& x: segments) {
+        if (x.is_index) {
+            ret += '[';
+            ret += std::to_string(x.index);
+            ret += ']';
+        } else {
+            if (!ret.empty()) { ret += '.'; }
+            ret += x.key;
+        }
+    }
+    return ret;
+}
+
+
+std::string ValidationError::message() const {
+    auto ret = path();
+    if (!ret.empty()) { ret += ": "; }
+    return ret + describe(code);
+}
+
+
+namespace validation {
+
+
+std::vector<Segment> capture(Path const* path) {
+    std::size_t size = 0;
+    for (auto x = path; x; x = x->parent) { ++size; }
+
+    std::vector<Segment> ret(size);
+    for (auto x = path; x; x = x->parent) {
+        auto& segment = ret[--size];
+        segment.key = x->key;
+        segment.index = x->index;
+        segment.is_index = x->is_index;
+    }
+    return ret;
+}
+
+
+} // namespace validation
+
+
+}
@@ -26,49 +26,226 @@
 // ifce
 #include <serialize/variant.hpp>
 
+#ifndef SERIALIZE_ENABLE_NODE_POOL
+#define SERIALIZE_ENABLE_NODE_POOL 1
+#endif
+
 // local
+#include <serialize/algorithm/hash.hpp>
+#include <serialize/cbor.hpp>
+#include <serialize/format.hpp>
 #include <serialize/meta.hpp>
+#include <serialize/node_pool.hpp>
+#include <serialize/path.hpp>
 #include <serialize/pimpl_impl.hpp>
 #include <serialize/type_name.hpp>
 
 // 3rd
+#include <rapidjson/reader.h>
 #include <rapidjson/stringbuffer.h>
 #include <rapidjson/writer.h>
 #include <rapidjson/error/en.h>
 
 // std
-#include <unordered_map>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <vector>
+#include <utility>
 #include <variant>
 #include <deque>
+#include <limits>
+#include <stdexcept>
 #include <typeinfo>
 
 
 namespace serialize {
 
 
-using Val = Variant::Types::push_front<std::monostate>::rebind<std::variant>;
+static_assert(sizeof(signed long) == sizeof(std::int64_t));
+
+
+namespace {
+
+
+/// An integer widened to 64 bits, `type` is the one it was given as
+template <typename T>
+struct Widened {
+    bool operator==(Widened const& rhs) const noexcept {
+        return value == rhs.value;
+    }
+
+    bool operator!=(Widened const& rhs) const noexcept {
+        return value != rhs.value;
+    }
+
+    T value;
+    std::type_info const* type;
+};
+
+
+using Signed = Widened<std::int64_t>;
+using Unsigned = Widened<std::uint64_t>;
+
+
+} // namespace
+
+
+/// The integral `Types` share two alternatives, which keeps the visitation
+/// tables small and makes equal values equal whatever their type
+using Val = std::variant<std::monostate,
+                         bool,
+                         Signed,
+                         Unsigned,
+                         double,
+                         std::string,
+                         Variant::Vec,
+                         Variant::Map>;
+
+
+namespace {
+
+
+/// Values fitting `std::int64_t` are always `Signed`
+template <typename T>
+Val widen(T x) noexcept {
+    if constexpr (std::is_signed_v<T>) {
+        return Signed{x, &typeid(T)};
+    } else if (x <= std::uint64_t(std::numeric_limits<std::int64_t>::max())) {
+        return Signed{std::int64_t(x), &typeid(T)};
+    } else {
+        return Unsigned{x, &typeid(T)};
+    }
+}
+
+
+} // namespace
 
 
 struct Variant::Impl {
+    Impl() = default;
+
+    template <typename T,
+              typename = std::enable_if_t<!std::is_same_v<std::decay_t<T>, Impl>>>
+    Impl(T&& x) : m(std::forward<T>(x)) {}
+
+    /// Copies are not frozen
+    Impl(Impl const& rhs) : m(rhs.m) {}
+
+#if SERIALIZE_ENABLE_NODE_POOL
+    static void* operator new(std::size_t size) {
+        return NodePool::allocate(size);
+    }
+
+    static void operator delete(void* p, std::size_t size) noexcept {
+        NodePool::deallocate(p, size);
+    }
+#endif
+
     Val m;
+
+    /// Structural hash of `m`, 0 unless frozen
+    std::uint64_t hash = 0;
+
+    /// A `member` belongs to a frozen value, a `root` does not
+    enum class State : std::uint8_t { thawed, root, member };
+    State state = State::thawed;
 };
 
 
 Variant::Variant() = default;
 
 
-Variant::~Variant() = default;
+namespace {
+
+
+/// Whether `x` is part of a frozen value, which must not change
+template <typename Impl>
+bool frozenMember(Pimpl<Impl> const& x) noexcept {
+    auto const p = x.operator->();
+    return p != nullptr && p->state == Impl::State::member;
+}
+
+
+/// Makes a value moved out of a frozen one frozen on its own, its cached
+/// hashes still hold
+template <typename Impl>
+void detachMember(Pimpl<Impl>& x) noexcept {
+    if (frozenMember(x)) { x->state = Impl::State::root; }
+}
+
+
+} // namespace
+
+
+namespace {
+
+
+/// Nesting of the `~Variant` calls tearing down containers on this thread
+thread_local std::size_t destroy_depth = 0;
+
+
+/// Deeper trees are torn down with an explicit stack
+constexpr std::size_t max_destroy_depth = 128;
+
+
+} // namespace
+
+
+Variant::~Variant() {
+    auto const p = impl.operator->();
+    if (p == nullptr || !(std::holds_alternative<Vec>(p->m) ||
+                          std::holds_alternative<Map>(p->m))) {
+        return;
+    }
+
+    if (destroy_depth < max_destroy_depth) {
+        ++destroy_depth;
+        p->m = std::monostate();
+        --destroy_depth;
+        return;
+    }
+
+    // children are moved out before their parents die, so none of the
+    // destructors below recurse
+    std::vector<Variant> pending;
+    auto const detach = [&pending](Val& x) {
+        auto const keep = [&pending](Variant& y) {
+            auto const& m = y.impl->m;
+            auto const* vec = std::get_if<Vec>(&m);
+            auto const* map = std::get_if<Map>(&m);
+            if ((vec && !vec->empty()) || (map && !map->empty())) {
+                y.impl->state = Impl::State::thawed;
+                pending.push_back(std::move(y));
+            }
+        };
+
+        if (auto const vec = std::get_if<Vec>(&x)) {
+            for (auto& y: *vec) { keep(y); }
+            vec->clear();
+        } else if (auto const map = std::get_if<Map>(&x)) {
+            for (auto&& y: *map) { keep(y.second); }
+            map->clear();
+        }
+    };
+
+    detach(p->m);
+    while (!pending.empty()) {
+        auto x = std::move(pending.back());
+        pending.pop_back();
+        detach(x.impl->m);
+    }
+}
 
 
 Variant::Variant(bool x) : impl(x) {}
-Variant::Variant(char x) : impl(x) {}
-Variant::Variant(short int x) : impl(x) {}
-Variant::Variant(unsigned short int x) : impl(x) {}
-Variant::Variant(int x) : impl(x) {}
-Variant::Variant(unsigned int x) : impl(x) {}
-Variant::Variant(signed long x) : impl(x) {}
-Variant::Variant(unsigned long x) : impl(x) {}
+Variant::Variant(char x) : impl(widen(x)) {}
+Variant::Variant(short int x) : impl(widen(x)) {}
+Variant::Variant(unsigned short int x) : impl(widen(x)) {}
+Variant::Variant(int x) : impl(widen(x)) {}
+Variant::Variant(unsigned int x) : impl(widen(x)) {}
+Variant::Variant(signed long x) : impl(widen(x)) {}
+Variant::Variant(unsigned long x) : impl(widen(x)) {}
 Variant::Variant(double x) : impl(x) {}
 
 
@@ -86,11 +263,51 @@ Variant::Variant(Map&& x) : impl(std::move(x)) {}
 
 
 Variant::Variant(Variant const&) = default;
-Variant& Variant::operator=(Variant const&) = default;
 
 
-Variant::Variant(Variant&&) noexcept = default;
-Variant& Variant::operator=(Variant&&) noexcept = default;
+Variant& Variant::operator=(Variant const& rhs) {
+    if (frozenMember(impl)) { throw VariantFrozen(); }
+    impl = rhs.impl;
+    return *this;
+}
+
+
+Variant::Variant(Variant&& rhs) noexcept : impl(std::move(rhs.impl)) {
+    detachMember(impl);
+}
+
+
+Variant& Variant::operator=(Variant&& rhs) noexcept {
+    impl = std::move(rhs.impl);
+    detachMember(impl);
+    return *this;
+}
+
+
+void Variant::thaw() {
+    switch (impl->state) {
+    case Impl::State::thawed:
+        return;
+    case Impl::State::member:
+        throw VariantFrozen();
+    case Impl::State::root:
+        break;
+    }
+
+    // the children stay frozen until modified through this object
+    impl->state = Impl::State::thawed;
+    impl->hash = 0;
+    if (auto const vec = std::get_if<Vec>(&impl->m)) {
+        for (auto& y: *vec) { y.impl->state = Impl::State::root; }
+    } else if (auto const map = std::get_if<Map>(&impl->m)) {
+        for (auto&& y: *map) { y.second.impl->state = Impl::State::root; }
+    }
+}
+
+
+bool Variant::empty() const noexcept {
+    return std::holds_alternative<std::monostate>(impl->m);
+}
 
 
 namespace {
@@ -242,38 +459,57 @@ struct GetHelper<T, When<std::is_integral_v<T>>> {
         return integralCheckedCast<T>(x);
     }
 
-    T operator()(char x)               const {
-        return integralCheckedCast<T>(x);
+    T operator()(Signed x)             const {
+        return integralCheckedCast<T>(x.value);
     }
 
-    T operator()(short int x)          const {
-        return integralCheckedCast<T>(x);
+    T operator()(Unsigned x)           const {
+        return integralCheckedCast<T>(x.value);
     }
 
-    T operator()(unsigned short int x) const {
-        return integralCheckedCast<T>(x);
-    }
+    template <typename U>
+    [[noreturn]] T operator()(U const&) const { throw VariantBadType(); }
+};
 
-    T operator()(int x)                const {
-        return integralCheckedCast<T>(x);
-    }
 
-    T operator()(unsigned int x)       const {
-        return integralCheckedCast<T>(x);
+/// Is the integral `x` representable in `T`
+template <typename T, typename U>
+constexpr bool fits(U x) noexcept {
+    if constexpr (std::is_same_v<U, bool>) {
+        (void) x;
+        return true;
+    } else if constexpr (same_sign_v<T, U>) {
+        return x >= std::numeric_limits<T>::min() &&
+               x <= std::numeric_limits<T>::max();
+    } else if constexpr (std::is_signed_v<U>) {
+        return x >= 0 &&
+               std::make_unsigned_t<U>(x) <= std::numeric_limits<T>::max();
+    } else {
+        return x <= std::make_unsigned_t<T>(std::numeric_limits<T>::max());
     }
+}
 
-    T operator()(signed long x)        const {
-        return integralCheckedCast<T>(x);
-    }
 
-    T operator()(unsigned long x)      const {
-        return integralCheckedCast<T>(x);
-    }
+template <typename T, typename = void>
+struct IsHelper : IsHelper<T, When<true>> {};
+
+
+template <typename T, bool condition>
+struct IsHelper<T, When<condition>> {
+    bool operator()(T const&) const noexcept { return true; }
+    template <typename U>
+    bool operator()(U const&) const noexcept { return false; }
+};
+
+
+template <typename T>
+struct IsHelper<T, When<std::is_integral_v<T>>> {
+    bool operator()(bool) const noexcept { return true; }
+    bool operator()(Signed x) const noexcept { return fits<T>(x.value); }
+    bool operator()(Unsigned x) const noexcept { return fits<T>(x.value); }
 
-    T operator()(double)       const { throw VariantBadType(); }
-    T operator()(std::string)  const { throw VariantBadType(); }
-    T operator()(Variant::Vec) const { throw VariantBadType(); }
-    T operator()(Variant::Map) const { throw VariantBadType(); }
+    template <typename U>
+    bool operator()(U const&) const noexcept { return false; }
 };
 
 
@@ -398,6 +634,13 @@ Variant::Vec const& Variant::vec() const {
 }
 
 
+Variant::Vec& Variant::vecMut() {
+    auto& ret = const_cast<Vec&>(std::as_const(*this).vec());
+    thaw();
+    return ret;
+}
+
+
 Variant::Vec Variant::vecOr(Vec const& x) const {
     return std::visit(GetOrHelper<Vec>{x}, impl->m);
 }
@@ -408,18 +651,352 @@ Variant::Map const& Variant::map() const {
 }
 
 
+template <typename T>
+bool Variant::is() const noexcept {
+    return std::visit(IsHelper<T>(), impl->m);
+}
+
+
+template bool Variant::is<bool>() const noexcept;
+template bool Variant::is<char>() const noexcept;
+template bool Variant::is<short int>() const noexcept;
+template bool Variant::is<unsigned short int>() const noexcept;
+template bool Variant::is<int>() const noexcept;
+template bool Variant::is<unsigned int>() const noexcept;
+template bool Variant::is<signed long>() const noexcept;
+template bool Variant::is<unsigned long>() const noexcept;
+template bool Variant::is<double>() const noexcept;
+template bool Variant::is<std::string>() const noexcept;
+template bool Variant::is<Variant::Vec>() const noexcept;
+template bool Variant::is<Variant::Map>() const noexcept;
+
+
+Variant::Map& Variant::mapMut() {
+    auto& ret = const_cast<Map&>(std::as_const(*this).map());
+    thaw();
+    return ret;
+}
+
+
 Variant::Map Variant::mapOr(Map const& x) const {
     return std::visit(GetOrHelper<Map>{x}, impl->m);
 }
 
 
+Variant& Variant::operator[](std::string_view key) {
+    thaw();
+    if (empty()) { impl->m = Map(); }
+    return mapMut()[key];
+}
+
+
+std::pair<Variant::Map::iterator, bool> Variant::emplace(std::string key,
+                                                         Variant x) {
+    thaw();
+    if (empty()) { impl->m = Map(); }
+    return mapMut().try_emplace(std::move(key), std::move(x));
+}
+
+
+void Variant::push_back(Variant x) {
+    thaw();
+    if (empty()) { impl->m = Vec(); }
+    vecMut().push_back(std::move(x));
+}
+
+
+std::size_t Variant::erase(std::string_view key) {
+    return mapMut().erase(key);
+}
+
+
+void Variant::erase(std::size_t index) {
+    auto& vec = vecMut();
+    if (index >= vec.size()) { throw std::out_of_range("Variant::erase"); }
+    vec.erase(vec.begin() + std::ptrdiff_t(index));
+}
+
+
+void Variant::reserve(std::size_t n) {
+    if (std::holds_alternative<Vec>(impl->m)) {
+        vecMut().reserve(n);
+    } else {
+        mapMut().reserve(n);
+    }
+}
+
+
+Variant const* Variant::find(Path const& path) const noexcept {
+    auto ret = this;
+    for (auto const& step: path.steps()) {
+        ret = Path::child(*ret, step);
+        if (!ret) { break; }
+    }
+    return ret;
+}
+
+
+Variant const& Variant::at(Path const& path) const {
+    if (auto const ret = find(path)) { return *ret; }
+    throw PathError("no value at '" + path.str() + "'");
+}
+
+
+namespace {
+
+
+struct HashHelper {
+    std::uint64_t operator()(std::monostate) const noexcept { return 0; }
+
+    template <typename T,
+              typename = std::enable_if_t<std::is_integral_v<T>>>
+    std::uint64_t operator()(T x) const noexcept {
+        return static_cast<std::uint64_t>(x);
+    }
+
+    template <typename T>
+    std::uint64_t operator()(Widened<T> x) const noexcept {
+        return static_cast<std::uint64_t>(x.value);
+    }
+
+    std::uint64_t operator()(double x) const noexcept {
+        if (x == 0) { x = 0; } // -0 equals 0
+        std::uint64_t ret;
+        std::memcpy(&ret, &x, sizeof(ret));
+        return ret;
+    }
+
+    std::uint64_t operator()(std::string const& x) const noexcept {
+        return fnv1a(x);
+    }
+
+    std::uint64_t operator()(Variant::Vec const&) const noexcept {
+        return children;
+    }
+
+    std::uint64_t operator()(Variant::Map const&) const noexcept {
+        return children;
+    }
+
+    /// Combined hashes of the children of a container
+    std::uint64_t children;
+};
+
+
+} // namespace
+
+
+template <typename F>
+std::uint64_t Variant::hashTree(F&& f, bool every) const {
+    // the children are hashed before their parents, which combine them
+    // on a stack, the subtrees of frozen values are not visited unless
+    // `every` node is needed
+    struct Hasher {
+        bool enter(Variant const& x, std::string const*, std::size_t) {
+            children.push_back(x.is<Map>() ? 0 : fnv_basis);
+            return every || x.impl->state == Impl::State::thawed;
+        }
+
+        void leave(Variant const& x, std::string const* key, std::size_t) {
+            auto ret = x.impl->hash;
+            if (x.impl->state == Impl::State::thawed) {
+                ret = hashCombine(hashCombine(fnv_basis, x.impl->m.index()),
+                                  std::visit(HashHelper{children.back()}, x.impl->m));
+                if (ret == 0) { ret = 1; }
+            }
+            children.pop_back();
+            f(x, ret);
+
+            if (children.empty()) {
+                root = ret;
+            } else if (key) {
+                // independent of the order of the entries
+                children.back() += hashCombine(fnv1a(*key), ret);
+            } else {
+                children.back() = hashCombine(children.back(), ret);
+            }
+        }
+
+        F& f;
+        bool every;
+        boost::container::small_vector<std::uint64_t, 32> children;
+        std::uint64_t root;
+    };
+
+    Hasher hasher{f, every, {}, 0};
+    walk(hasher);
+    return hasher.root;
+}
+
+
+std::uint64_t Variant::hash() const {
+    if (impl->state != Impl::State::thawed) { return impl->hash; }
+    return hashTree([](Variant const&, std::uint64_t) noexcept {}, false);
+}
+
+
+void Variant::hashEach(
+    std::function<void(Variant const&, std::uint64_t)> const& f) const
+{
+    hashTree(f, true);
+}
+
+
+void Variant::freeze() {
+    if (impl->state != Impl::State::thawed) { return; }
+    // the frozen values met become members as well
+    hashTree([](Variant const& x, std::uint64_t hash) noexcept {
+        auto& node = const_cast<Impl&>(*x.impl);
+        node.hash = hash;
+        node.state = Impl::State::member;
+    }, false);
+    impl->state = Impl::State::root;
+}
+
+
+bool Variant::frozen() const noexcept {
+    return impl->state != Impl::State::thawed;
+}
+
+
+namespace {
+
+
+/// Bytes of `x` beyond its small buffer
+std::size_t heapBytes(std::string const& x) noexcept {
+    static std::size_t const small = std::string().capacity();
+    return x.capacity() > small ? x.capacity() + 1 : 0;
+}
+
+
+} // namespace
+
+
+std::size_t Variant::memoryUsage() const { return stats().bytes; }
+
+
+Variant::Stats Variant::stats() const {
+    struct Accountant {
+        bool enter(Variant const& x, std::string const* key, std::size_t) {
+            ret.max_depth = std::max(ret.max_depth, ++depth);
+            ++ret.allocations;
+            ret.bytes += sizeof(Impl);
+
+            if (key) {
+                std::size_t bucket = 0;
+                for (auto n = key->size(); n != 0; n >>= 1) { ++bucket; }
+                ++ret.key_lengths[std::min(bucket, ret.key_lengths.size() - 1)];
+                if (auto const n = heapBytes(*key)) {
+                    ++ret.allocations;
+                    ret.bytes += n;
+                }
+            }
+
+            std::visit(Overload{
+                [&](std::monostate) { ++ret.nulls; },
+                [&](bool) { ++ret.booleans; },
+                [&](double) { ++ret.floatings; },
+                [&](auto) { ++ret.integers; },
+                [&](std::string const& x) {
+                    ++ret.strings;
+                    if (auto const n = heapBytes(x)) {
+                        ++ret.allocations;
+                        ret.bytes += n;
+                    }
+                },
+                [&](Variant::Vec const& x) {
+                    ++ret.vecs;
+                    ret.allocations += x.capacity() != 0;
+                    ret.bytes += x.capacity() * sizeof(Variant);
+                },
+                [&](Variant::Map const& x) {
+                    ++ret.maps;
+                    ret.allocations += x.allocatedBlocks();
+                    ret.bytes += x.allocatedBytes();
+                }
+            }, x.impl->m);
+            return true;
+        }
+
+        void leave(Variant const&, std::string const*, std::size_t) noexcept {
+            --depth;
+        }
+
+        Stats ret;
+        std::size_t depth;
+    };
+
+    Accountant accountant{{}, 0};
+    walk(accountant);
+    return accountant.ret;
+}
+
+
 bool Variant::operator==(Variant const& rhs) const noexcept {
-    return impl->m == rhs.impl->m;
+    /// Walks `*this` keeping the path of the matching values of `rhs`
+    struct Comparer {
+        /// Counterpart of the child `key` or `index` of the top of `others`
+        Variant const* other(std::string const* key, std::size_t index) const noexcept {
+            if (others.empty()) { return &rhs; }
+            auto const& parent = others.back()->impl->m;
+            if (auto const vec = std::get_if<Vec>(&parent)) {
+                return &(*vec)[index];
+            }
+            auto const& map = *std::get_if<Map>(&parent);
+            auto const it = map.find(*key);
+            return it == map.end() ? nullptr : &it->second;
+        }
+
+        bool enter(Variant const& x, std::string const* key, std::size_t index) noexcept {
+            auto const y = equal ? other(key, index) : nullptr;
+            others.push_back(y);
+            if (y == nullptr) {
+                equal = false;
+                return false;
+            }
+            if (&x == y) { return false; }
+
+            // only frozen values have a hash, which they cannot outdate
+            auto const a = x.impl->hash;
+            auto const b = y->impl->hash;
+            if (a != 0 && b != 0 && a != b) {
+                equal = false;
+                return false;
+            }
+
+            auto const& m = x.impl->m;
+            auto const& n = y->impl->m;
+            if (auto const vec = std::get_if<Vec>(&m)) {
+                auto const rhs_vec = std::get_if<Vec>(&n);
+                equal = rhs_vec && rhs_vec->size() == vec->size();
+                return equal;
+            }
+            if (auto const map = std::get_if<Map>(&m)) {
+                auto const rhs_map = std::get_if<Map>(&n);
+                equal = rhs_map && rhs_map->size() == map->size();
+                return equal;
+            }
+            equal = m == n;
+            return false;
+        }
+
+        void leave(Variant const&, std::string const*, std::size_t) noexcept {
+            others.pop_back();
+        }
+
+        Variant const& rhs;
+        boost::container::small_vector<Variant const*, 32> others;
+        bool equal;
+    };
+
+    Comparer comparer{rhs, {}, true};
+    walk(comparer);
+    return comparer.equal;
 }
 
 
 bool Variant::operator!=(Variant const& rhs) const noexcept {
-    return impl->m != rhs.impl->m;
+    return !(*this == rhs);
 }
 
 
@@ -429,24 +1006,53 @@ namespace {
 using namespace rapidjson;
 
 
-/// RapidJSON visitor
+/// SAX handler building a `Variant`, shared by the JSON and CBOR readers
 template <typename Ch>
-struct FromRapidJsonValue {
+struct VariantBuilder {
     bool Null()                 { val(Variant());    return true; }
     bool Bool(bool b)           { val(Variant(b));   return true; }
     bool Int(int i)             { val(Variant(i));   return true; }
     bool Uint(unsigned u)       { val(Variant(u));   return true; }
-    bool Int64(int64_t i64)     { val(Variant(i64)); return true; }
-    bool Uint64(uint64_t u64)   { val(Variant(u64)); return true; }
     bool Double(double d)       { val(Variant(d));   return true; }
 
+    /// Picks the narrowest type the same way RapidJSON does
+    bool Int64(int64_t i64) {
+        if (i64 >= std::numeric_limits<int>::min() &&
+                i64 <= std::numeric_limits<int>::max()) {
+            return Int(static_cast<int>(i64));
+        }
+        if (i64 >= 0 && i64 <= std::numeric_limits<unsigned>::max()) {
+            return Uint(static_cast<unsigned>(i64));
+        }
+        val(Variant(i64));
+        return true;
+    }
+
+    bool Uint64(uint64_t u64) {
+        if (u64 <= static_cast<uint64_t>(std::numeric_limits<int64_t>::max())) {
+            return Int64(static_cast<int64_t>(u64));
+        }
+        val(Variant(u64));
+        return true;
+    }
+
     bool String(const Ch* str, SizeType length, bool) {
         val(Variant(std::string(str, length)));
         return true;
     }
 
-    bool StartObject() {
-        stack.push_back(KeyCarriedMap());
+    bool String(std::string_view str) {
+        val(Variant(std::string(str)));
+        return true;
+    }
+
+    /// `Variant` has no byte string type, keep the raw bytes in a string
+    bool Bytes(std::string_view str) { return String(str); }
+
+    bool StartObject(std::size_t size = cbor::indefinite) {
+        KeyCarriedMap x;
+        x.map.reserve(hint(size));
+        stack.push_back(std::move(x));
         return true;
     }
 
@@ -455,7 +1061,12 @@ struct FromRapidJsonValue {
         return true;
     }
 
-    bool EndObject(SizeType) {
+    bool Key(std::string_view str) {
+        key(std::string(str));
+        return true;
+    }
+
+    bool EndObject(SizeType = 0) {
         std::visit([this](auto& x) {
                        finish_v(x,
                                 std::visit(res_v, std::move(stack.back()))); },
@@ -464,12 +1075,14 @@ struct FromRapidJsonValue {
         return true;
     }
 
-    bool StartArray() {
-        stack.push_back(Variant::Vec());
+    bool StartArray(std::size_t size = cbor::indefinite) {
+        Variant::Vec x;
+        x.reserve(hint(size));
+        stack.push_back(std::move(x));
         return true;
     }
 
-    bool EndArray(SizeType) {
+    bool EndArray(SizeType = 0) {
         std::visit([this](auto& x) {
                        finish_v(x,
                                 std::visit(res_v, std::move(stack.back()))); },
@@ -522,7 +1135,7 @@ struct FromRapidJsonValue {
 
     struct Res {
         Variant operator()(Variant&& x) const {
-            return x;
+            return std::move(x);
         }
 
         Variant operator()(Variant::Vec&& x) const {
@@ -538,11 +1151,23 @@ struct FromRapidJsonValue {
         std::visit(value_v, stack.back()) = std::move(x);
     }
 
+    /// Part of the announced `size` to reserve, taken from `reserve_budget`
+    std::size_t hint(std::size_t size) {
+        if (size == cbor::indefinite) { return 0; }
+        auto const ret = std::min(size, reserve_budget);
+        reserve_budget -= ret;
+        return ret;
+    }
+
     void key(std::string&& x) {
         std::visit(key_v, stack.back()) = std::move(x);
     }
 
     std::vector<Stack> stack{Variant()};
+
+    /// Items the size hints may still reserve. CBOR sizes are only checked
+    /// against the unread input, which every nesting level counts again.
+    std::size_t reserve_budget = std::numeric_limits<std::size_t>::max();
     Val const value_v{};
     struct Key const key_v{};
     Finish const finish_v{};
@@ -553,101 +1178,255 @@ struct FromRapidJsonValue {
 } // namespace
 
 
+/// Not through `Value::Accept`, which recurses on nested values
 Variant Variant::from(Value const& json) {
-    FromRapidJsonValue<Value::Ch> ser;
-    json.Accept(ser);
+    struct Frame {
+        Value const* x;
+        SizeType next;
+    };
+
+    VariantBuilder<Value::Ch> ser;
+    boost::container::small_vector<Frame, 32> stack;
+    auto const start = [&](Value const& x) {
+        if (x.IsArray()) {
+            ser.StartArray(x.Size());
+            stack.push_back(Frame{&x, 0});
+        } else if (x.IsObject()) {
+            ser.StartObject(x.MemberCount());
+            stack.push_back(Frame{&x, 0});
+        } else {
+            x.Accept(ser);
+        }
+    };
+
+    start(json);
+    while (!stack.empty()) {
+        auto& top = stack.back();
+        auto const& x = *top.x;
+        if (x.IsArray() && top.next < x.Size()) {
+            start(*(x.Begin() + top.next++));
+        } else if (x.IsObject() && top.next < x.MemberCount()) {
+            auto const& member = *(x.MemberBegin() + top.next++);
+            ser.Key(member.name.GetString(), member.name.GetStringLength(), true);
+            start(member.value);
+        } else {
+            if (x.IsArray()) {
+                ser.EndArray();
+            } else {
+                ser.EndObject();
+            }
+            stack.pop_back();
+        }
+    }
+
     return std::visit(ser.res_v, std::move(ser.stack.front()));
 }
 
 
+/// Parsed iteratively straight into the `Variant`, without a DOM
 Variant Variant::fromJson(std::string const& json) {
-    rapidjson::Document d;
-    if (d.Parse(json.c_str()).HasParseError()) {
-        throw std::runtime_error(rapidjson::GetParseError_En(d.GetParseError()));
+    VariantBuilder<char> ser;
+    rapidjson::Reader reader;
+    rapidjson::StringStream stream(json.c_str());
+    if (!reader.Parse<rapidjson::kParseIterativeFlag>(stream, ser)) {
+        throw std::runtime_error(
+            rapidjson::GetParseError_En(reader.GetParseErrorCode()));
     }
-    return Variant::from(d);
+    return std::visit(ser.res_v, std::move(ser.stack.front()));
 }
 
 
 rapidjson::Document& Variant::to(rapidjson::Document& json) const {
-    std::visit(Overload{
-        [&](std::monostate) { json.SetNull(); },
-        [&](bool x) { json.SetBool(x); },
-        [&](char x) { json.SetInt(x); },
-        [&](short int x) { json.SetInt(x); },
-        [&](unsigned short int x) { json.SetUint(x); },
-        [&](int x) { json.SetInt(x); },
-        [&](unsigned int x) { json.SetUint(x); },
-        [&](signed long x) { json.SetInt64(x); },
-        [&](unsigned long x) { json.SetUint64(x); },
-        [&](double x) { json.SetDouble(x); },
-        [&](std::string const& x) {
-            json.SetString(x.c_str(), json.GetAllocator());
-        },
-        [&](Variant::Vec const& vec) {
-            json.SetArray();
-            for (auto const& x: vec) {
-                rapidjson::Document tmp;
-                x.to(tmp);
-                json.PushBack(
-                    rapidjson::Value(tmp.Move(), json.GetAllocator()),
-                    json.GetAllocator());
-            }
-        },
-        [&](Variant::Map const& map) {
-            json.SetObject();
-            for (auto const& [key, x]: map) {
-                rapidjson::Document tmp;
-                x.to(tmp);
-                json.AddMember(
-                    rapidjson::Value(key.c_str(), json.GetAllocator()),
-                    rapidjson::Value(tmp.Move(), json.GetAllocator()),
-                    json.GetAllocator());
+    /// Values are built on a stack and moved into their parents when done
+    struct Builder {
+        bool enter(Variant const& x, std::string const*, std::size_t) {
+            auto& alloc = json.GetAllocator();
+            rapidjson::Value y;
+            std::visit(Overload{
+                [&](std::monostate) {},
+                [&](bool x) { y.SetBool(x); },
+                [&](Signed x) { y.SetInt64(x.value); },
+                [&](Unsigned x) { y.SetUint64(x.value); },
+                [&](double x) { y.SetDouble(x); },
+                [&](std::string const& x) {
+                    y.SetString(x.data(), SizeType(x.size()), alloc);
+                },
+                [&](Variant::Vec const&) { y.SetArray(); },
+                [&](Variant::Map const&) { y.SetObject(); }
+            }, x.impl->m);
+            values.push_back(std::move(y));
+            return true;
+        }
+
+        void leave(Variant const&, std::string const* key, std::size_t) {
+            auto& alloc = json.GetAllocator();
+            auto y = std::move(values.back());
+            values.pop_back();
+            if (values.empty()) {
+                static_cast<rapidjson::Value&>(json) = std::move(y);
+            } else if (key) {
+                values.back().AddMember(
+                    rapidjson::Value(key->data(), SizeType(key->size()), alloc),
+                    std::move(y), alloc);
+            } else {
+                values.back().PushBack(std::move(y), alloc);
             }
         }
-    }, impl->m);
 
+        rapidjson::Document& json;
+        std::vector<rapidjson::Value> values;
+    };
+
+    walk(Builder{json, {}});
     return json;
 }
 
 
+/// Written straight from the `Variant`, without a DOM
 std::string Variant::toJson() const {
-    rapidjson::Document doc;
-    to(doc);
+    using JsonWriter = rapidjson::Writer<rapidjson::StringBuffer>;
+
+    struct Emitter {
+        bool enter(Variant const& x, std::string const* key, std::size_t) {
+            if (key) { writer.Key(key->data(), SizeType(key->size())); }
+            std::visit(Overload{
+                [&](std::monostate) { writer.Null(); },
+                [&](bool x) { writer.Bool(x); },
+                [&](Signed x) { writer.Int64(x.value); },
+                [&](Unsigned x) { writer.Uint64(x.value); },
+                [&](double x) { writer.Double(x); },
+                [&](std::string const& x) {
+                    writer.String(x.data(), SizeType(x.size()));
+                },
+                [&](Variant::Vec const&) { writer.StartArray(); },
+                [&](Variant::Map const&) { writer.StartObject(); }
+            }, x.impl->m);
+            return true;
+        }
+
+        void leave(Variant const& x, std::string const*, std::size_t) {
+            if (std::holds_alternative<Vec>(x.impl->m)) {
+                writer.EndArray();
+            } else if (std::holds_alternative<Map>(x.impl->m)) {
+                writer.EndObject();
+            }
+        }
+
+        JsonWriter& writer;
+    };
 
     rapidjson::StringBuffer sb;
-    rapidjson::Writer<rapidjson::StringBuffer> writer(sb);
-    doc.Accept(writer);
+    JsonWriter writer(sb);
+    walk(Emitter{writer});
 
     return sb.GetString();
 }
 
 
+Variant Variant::fromCbor(std::string_view data) {
+    VariantBuilder<char> ser;
+    ser.reserve_budget = data.size();
+    cbor::Reader reader(data);
+    if (reader.parse(ser) != data.size()) {
+        throw cbor::CborError("trailing bytes after data item");
+    }
+    return std::visit(ser.res_v, std::move(ser.stack.front()));
+}
+
+
+cbor::Writer& Variant::to(cbor::Writer& cbor) const {
+    struct Encoder {
+        bool enter(Variant const& x, std::string const* key, std::size_t) {
+            if (key) { cbor.Key(*key); }
+            std::visit(Overload{
+                [&](std::monostate) { cbor.Null(); },
+                [&](bool x) { cbor.Bool(x); },
+                [&](Signed x) { cbor.Int64(x.value); },
+                [&](Unsigned x) { cbor.Uint64(x.value); },
+                [&](double x) { cbor.Double(x); },
+                [&](std::string const& x) { cbor.String(x); },
+                [&](Variant::Vec const& vec) { cbor.StartArray(vec.size()); },
+                [&](Variant::Map const& map) { cbor.StartObject(map.size()); }
+            }, x.impl->m);
+            return true;
+        }
+
+        void leave(Variant const& x, std::string const*, std::size_t) {
+            if (std::holds_alternative<Vec>(x.impl->m)) {
+                cbor.EndArray();
+            } else if (std::holds_alternative<Map>(x.impl->m)) {
+                cbor.EndObject();
+            }
+        }
+
+        cbor::Writer& cbor;
+    };
+
+    walk(Encoder{cbor});
+    return cbor;
+}
+
+
+std::string Variant::toCbor() const {
+    std::string ret;
+    cbor::Writer writer(ret);
+    to(writer);
+    return ret;
+}
+
+
+void Variant::appendTo(std::string& out) const {
+    struct Printer {
+        bool enter(Variant const& x, std::string const* key, std::size_t index) {
+            if (key) {
+                out += *key;
+                out += ": ";
+            } else if (index != 0) {
+                out += ", ";
+            }
+            std::visit(Overload{
+                [&](std::monostate) { out += "Null"; },
+                [&](bool x) { out += x ? '1' : '0'; },
+                [&](Signed x) { detail::appendChars(out, x.value); },
+                [&](Unsigned x) { detail::appendChars(out, x.value); },
+                [&](double x) {
+                    detail::appendChars(out, x, std::chars_format::fixed, 6);
+                },
+                [&](std::string const& str) { out += str; },
+                [&](Variant::Map const&) { out += "{ "; },
+                [&](Variant::Vec const&) { out += "[ "; }
+            }, x.impl->m);
+            return true;
+        }
+
+        void leave(Variant const& x, std::string const* key, std::size_t) {
+            if (auto const vec = std::get_if<Variant::Vec>(&x.impl->m)) {
+                out += vec->empty() ? "]" : " ]";
+            } else if (std::holds_alternative<Variant::Map>(x.impl->m)) {
+                out += "}";
+            }
+            if (key) { out += "; "; }
+        }
+
+        std::string& out;
+    };
+
+    walk(Printer{out});
+}
+
+
 std::ostream& operator<<(std::ostream& os, Variant const& var) {
-    std::visit(Overload{
-        [&](auto integral) { os << std::to_string(integral); },
-        [&](std::monostate) { os << "Null"; },
-        [&](std::string const& str)  { os << str; },
-        [&](Variant::Map const& map) {
-            os << "{ ";
-            for (auto const& [key, x]: map) { os << key << ": " << x << "; "; }
-            os << "}";
-        },
-        [&](Variant::Vec const& vec) {
-            auto const l = vec.size() - 1;
-            std::size_t i = 0;
-            os << "[ ";
-            for (auto const& x: vec) { os << x << ((i++ == l) ? " " : ", "); }
-            os << "]";
-        }
-    }, var.impl->m);
-    return os;
+    std::string out;
+    var.appendTo(out);
+    return os.write(out.data(), std::streamsize(out.size()));
 }
 
 
 std::type_info const& Variant::typeInfo() const {
     return std::visit(Overload{
-        [&](auto val) -> std::type_info const& { return typeid(val); }
+        [&](auto const& val) -> std::type_info const& { return typeid(val); },
+        [&](Signed x) -> std::type_info const& { return *x.type; },
+        [&](Unsigned x) -> std::type_info const& { return *x.type; }
     }, impl->m);
 }
 
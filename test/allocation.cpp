@@ -0,0 +1,302 @@
+/*
+  MIT License
+
+  Copyright (c) 2018 Nicolai Trandafil
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+// tested
+#include <serialize/patch.hpp>
+#include <serialize/variant_conversion.hpp>
+#include <serialize/variant_traits.hpp>
+
+// local
+#include <serialize/node_pool.hpp>
+
+// 3rd
+#include <catch2/catch.hpp>
+
+// boost
+#include <boost/hana.hpp>
+
+// std
+#include <cstdlib>
+#include <map>
+#include <new>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+namespace hana = boost::hana;
+
+
+using namespace serialize;
+
+
+namespace {
+
+
+bool counting{false};
+std::size_t allocations{0};
+
+
+/// Number of heap allocations made by `f`, with the nodes pooled before
+template <typename F>
+std::size_t countPooledAllocations(F&& f) {
+    allocations = 0;
+    counting = true;
+    f();
+    counting = false;
+    return allocations;
+}
+
+
+/// Number of heap allocations made by `f`, starting without pooled nodes
+template <typename F>
+std::size_t countAllocations(F&& f) {
+    NodePool::trim();
+    return countPooledAllocations(f);
+}
+
+
+struct Point : trait::Var<Point> {
+    int x{0};
+    int y{0};
+};
+
+
+struct Track : trait::Var<Track> {
+    std::string name;
+    std::optional<int> id;
+    std::vector<Point> points;
+};
+
+
+struct Config : trait::VarDef<Config> {
+    static auto defaults() {
+        return hana::make_map(hana::make_pair(BOOST_HANA_STRING("level"), 3));
+    }
+
+    std::string description;
+    int level{0};
+};
+
+
+struct Elide {
+    static constexpr auto serialize_empty_container = true;
+    static constexpr auto serialize_default_value = false;
+};
+
+
+struct Profile : trait::VarDef<Profile, Elide> {
+    static auto defaults() {
+        return hana::make_map(
+            hana::make_pair(BOOST_HANA_STRING("motto"),
+                            std::string(100, 'm')),
+            hana::make_pair(BOOST_HANA_STRING("tags"),
+                            std::vector<std::string>(4, std::string(100, 't'))));
+    }
+
+    std::string motto;
+    std::vector<std::string> tags;
+};
+
+
+struct Wide : trait::Var<Wide> {
+    int a_rather_long_member_name{0};
+};
+
+
+} // namespace
+
+
+void* operator new(std::size_t size) {
+    if (counting) { ++allocations; }
+    if (auto p = std::malloc(size ? size : 1)) { return p; }
+    throw std::bad_alloc();
+}
+
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+
+BOOST_HANA_ADAPT_STRUCT(Point, x, y);
+BOOST_HANA_ADAPT_STRUCT(Track, name, id, points);
+BOOST_HANA_ADAPT_STRUCT(Config, description, level);
+BOOST_HANA_ADAPT_STRUCT(Profile, motto, tags);
+BOOST_HANA_ADAPT_STRUCT(Wide, a_rather_long_member_name);
+
+
+TEST_CASE("Check conversion allocations", "[allocation]") {
+    // one `Variant` is one allocation, strings below are in SSO
+
+    SECTION("vector") {
+        std::vector<int> const x(100, 1);
+        Variant var;
+        // elements, buffer, result
+        REQUIRE(countAllocations([&] { var = toVariant(x); }) == 102);
+        REQUIRE(var.stats().allocations == 102);
+        // buffer
+        REQUIRE(countAllocations([&] { fromVariant<std::vector<int>>(var); }) == 1);
+    }
+
+    SECTION("map") {
+        std::map<std::string, int> const x{{"a", 1}, {"b", 2}, {"c", 3}};
+        Variant var;
+        // entries, hashes, values, result
+        REQUIRE(countAllocations([&] { var = toVariant(x); }) == 2 + 3 + 1);
+        REQUIRE(var.stats().allocations == 2 + 3 + 1);
+        // nodes
+        REQUIRE(countAllocations([&] {
+            fromVariant<std::map<std::string, int>>(var);
+        }) == 3);
+        // nodes, buckets
+        REQUIRE(countAllocations([&] {
+            fromVariant<std::unordered_map<std::string, int>>(var);
+        }) == 3 + 1);
+    }
+
+    SECTION("moved strings") {
+        std::vector<std::string> x(10, std::string(100, 'x'));
+        // elements, buffer, result, no string copies
+        REQUIRE(countAllocations([&] { toVariant(std::move(x)); }) == 12);
+    }
+
+    SECTION("struct") {
+        Track x;
+        x.name = "track";
+        x.id = 1;
+        x.points.resize(2);
+
+        Variant var;
+        // fields: entries, hashes, values, result
+        // points: 2 * (2 + 2 + 1), buffer
+        REQUIRE(countAllocations([&] { var = Track::toVariant(x); }) ==
+                2 + 3 + 1 + 2 * 5 + 1);
+        REQUIRE(var.stats().allocations == 2 + 3 + 1 + 2 * 5 + 1);
+        REQUIRE(countAllocations([&] { Track::toVariant(std::move(x)); }) ==
+                2 + 3 + 1 + 2 * 5 + 1);
+        // points buffer
+        REQUIRE(countAllocations([&] { Track::fromVariant(var); }) == 1);
+    }
+
+    SECTION("struct with defaults") {
+        Config x;
+        x.description = "config";
+        x.level = 3;
+
+        Variant var;
+        REQUIRE(countAllocations([&] { var = Config::toVariant(x); }) ==
+                2 + 2 + 1);
+        REQUIRE(countAllocations([&] { Config::fromVariant(var); }) == 0);
+    }
+
+    SECTION("defaults built once") {
+        auto const x = Profile::fromVariant(Variant(Variant::Map{}));
+        REQUIRE(x.motto == std::string(100, 'm'));
+        REQUIRE(x.tags.size() == 4);
+
+        // entries, hashes, result
+        REQUIRE(countAllocations([&] { Profile::toVariant(x); }) == 2 + 1);
+        // motto, tags: buffer, elements
+        REQUIRE(countAllocations([&] {
+            Profile::fromVariant(Variant(Variant::Map{}));
+        }) == 1 + 1 + 1 + 4);
+    }
+
+    SECTION("into existing objects") {
+        Track x;
+        x.name = std::string(100, 'n');
+        x.id = 1;
+        x.points.resize(3);
+
+        auto const var = Track::toVariant(x);
+        Track y;
+        fromVariantInto(y, var);
+        x.points[0].x = 7;
+        x.name.back() = 'm';
+        auto const next = Track::toVariant(x);
+
+        REQUIRE(countAllocations([&] { fromVariantInto(y, next); }) == 0);
+        REQUIRE(y.name == x.name);
+        REQUIRE(y.points[0].x == 7);
+
+        std::map<std::string, std::vector<int>> m{{"a", {1, 2}}, {"b", {3}}};
+        auto const m_var = toVariant(m);
+        REQUIRE(countAllocations([&] { fromVariantInto(m, m_var); }) == 0);
+    }
+
+    SECTION("merge moves the overlay") {
+        auto base = toVariant(std::map<std::string, std::vector<int>>{
+            {"list", {1, 2}}, {"other", {3}}});
+        auto const overlay = toVariant(std::map<std::string, std::vector<int>>{
+            {"list", std::vector<int>(100, 4)}});
+
+        auto replaced = base;
+        auto moved = overlay;
+        REQUIRE(countAllocations([&] {
+            merge(replaced, std::move(moved));
+        }) == 0);
+        REQUIRE(replaced.map().at("list").vec().size() == 100);
+
+        moved = overlay;
+        // elements buffer
+        REQUIRE(countAllocations([&] {
+            merge(base, std::move(moved), {MergePolicy::Arrays::concat});
+        }) == 1);
+        REQUIRE(base.map().at("list").vec().size() == 102);
+    }
+
+    SECTION("editing in place") {
+        auto doc = toVariant(std::map<std::string, std::vector<int>>{
+            {"list", std::vector<int>(100, 1)}, {"other", {3}}});
+        doc["list"].reserve(101);
+        // node
+        REQUIRE(countAllocations([&] { doc["list"].push_back(Variant(2)); }) == 1);
+        REQUIRE(countAllocations([&] { doc["other"] = Variant(4); }) == 1);
+        REQUIRE(countAllocations([&] { doc.erase("list"); }) == 0);
+        REQUIRE(doc.toJson() == R"({"other":4})");
+    }
+
+    SECTION("pooled nodes") {
+        std::vector<int> const x(100, 1);
+        REQUIRE(countAllocations([&] { toVariant(x); }) == 102);
+        // buffer
+        REQUIRE(countPooledAllocations([&] { toVariant(x); }) == 1);
+    }
+
+    SECTION("field names beyond the small string buffer") {
+        Wide x;
+        x.a_rather_long_member_name = 1;
+
+        Variant var;
+        // entries, hashes, key, value, result
+        REQUIRE(countAllocations([&] { var = Wide::toVariant(x); }) ==
+                2 + 1 + 1 + 1);
+        REQUIRE(countAllocations([&] { Wide::fromVariant(var); }) == 0);
+        REQUIRE(countAllocations([&] {
+            var.map().find("a_rather_long_member_name");
+        }) == 0);
+    }
+}
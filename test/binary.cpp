@@ -0,0 +1,206 @@
+/*
+  MIT License
+
+  Copyright (c) 2018 Nicolai Trandafil
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+// tested
+#include <serialize/binary.hpp>
+
+// local
+#include <serialize/comparison_traits.hpp>
+#include <serialize/variant_traits.hpp>
+
+// 3rd
+#include <catch2/catch.hpp>
+
+// boost
+#include <boost/hana.hpp>
+
+// std
+#include <limits>
+#include <map>
+#include <optional>
+#include <set>
+#include <string>
+#include <vector>
+
+
+namespace hana = boost::hana;
+
+
+using namespace serialize;
+
+
+using namespace hana::literals;
+using namespace std::literals;
+
+
+namespace {
+
+
+struct Hobby
+        : trait::Var<Hobby>
+        , trait::EqualityComparison<Hobby> {
+    Hobby() = default;
+    Hobby(int id, std::string const& description)
+        : id(id), description(description)
+    {}
+
+    int id{0};
+    std::string description;
+};
+
+
+struct Person
+        : trait::Var<Person>
+        , trait::EqualityComparison<Person> {
+    std::string name;
+    std::optional<int> age;
+    long balance{0};
+    unsigned long id{0};
+    double height{0};
+    bool active{false};
+    std::vector<Hobby> hobbies;
+    std::map<std::string, int> scores;
+    std::set<short> tags;
+};
+
+
+struct PersonD
+        : trait::VarDef<PersonD>
+        , trait::EqualityComparison<PersonD> {
+    static auto defaults() {
+        return hana::make_map(
+            hana::make_pair("name"_s, "Efendi"s),
+            hana::make_pair("level"_s, 3));
+    }
+
+    std::string name;
+    int level{0};
+    std::optional<std::string> nick;
+};
+
+
+struct Dynamic
+        : trait::Var<Dynamic>
+        , trait::EqualityComparison<Dynamic> {
+    int x{0};
+    Variant extra;
+};
+
+
+} // namespace
+
+
+BOOST_HANA_ADAPT_STRUCT(Hobby, id, description);
+BOOST_HANA_ADAPT_STRUCT(Person, name, age, balance, id, height, active, hobbies, scores, tags);
+BOOST_HANA_ADAPT_STRUCT(PersonD, name, level, nick);
+BOOST_HANA_ADAPT_STRUCT(Dynamic, x, extra);
+
+
+TEST_CASE("Check binary format", "[binary]") {
+    Person person;
+    person.name = "Alecu";
+    person.age = 25;
+    person.balance = std::numeric_limits<long>::min();
+    person.id = std::numeric_limits<unsigned long>::max();
+    person.height = 1.75;
+    person.active = true;
+    person.hobbies = {Hobby(1, "Hack"), Hobby(-2, "Barista")};
+    person.scores = {{"a", 1}, {"b", -1}};
+    person.tags = {-3, 7};
+
+    SECTION("round trip") {
+        auto const data = toBinary(person);
+        REQUIRE(fromBinary<Person>(data) == person);
+
+        person.age.reset();
+        REQUIRE(fromBinary<Person>(toBinary(person)) == person);
+    }
+
+    SECTION("smaller than JSON") {
+        Person small;
+        small.name = "Alecu";
+        small.age = 25;
+        small.hobbies = {Hobby(1, "Hack")};
+        REQUIRE(toBinary(small).size() * 3 < Person::toVariant(small).toJson().size());
+    }
+
+    SECTION("varint and zigzag") {
+        REQUIRE(toBinary(0).size() == 5);
+        REQUIRE(toBinary(-1).substr(4) == "\x01");
+        REQUIRE(toBinary(1).substr(4) == "\x02");
+        REQUIRE(toBinary(300u).substr(4) == "\xac\x02");
+        REQUIRE(fromBinary<long>(toBinary(std::numeric_limits<long>::min())) ==
+                std::numeric_limits<long>::min());
+    }
+
+    SECTION("defaults and optionals are elided") {
+        PersonD d;
+        d.name = "Efendi";
+        d.level = 3;
+        auto const data = toBinary(d);
+        REQUIRE(data.size() == 5);
+        REQUIRE(fromBinary<PersonD>(data) == d);
+
+        d.name = "Alecu";
+        d.nick = "A";
+        REQUIRE(toBinary(d).size() == 5 + 6 + 2);
+        REQUIRE(fromBinary<PersonD>(toBinary(d)) == d);
+    }
+
+    SECTION("Variant members") {
+        Dynamic x;
+        x.x = 5;
+        x.extra = Variant(Variant::Map{{"a", Variant(Variant::Vec{Variant(1)})}});
+        REQUIRE(fromBinary<Dynamic>(toBinary(x)) == x);
+    }
+
+    SECTION("schema mismatch and malformed input") {
+        auto const data = toBinary(person);
+        REQUIRE(binarySchemaFingerprint<Person>() != binarySchemaFingerprint<Hobby>());
+        REQUIRE_THROWS_AS(fromBinary<Hobby>(data), BinaryError);
+        REQUIRE_THROWS_AS(fromBinary<Person>(data.substr(0, data.size() - 1)), BinaryError);
+        REQUIRE_THROWS_AS(fromBinary<Person>(data + "x"), BinaryError);
+        REQUIRE_THROWS_AS(fromBinary<char>(toBinary(1000)), BinaryError);
+    }
+
+    SECTION("counts bounded by the input") {
+        using Ints = std::vector<int>;
+        auto const ints = toBinary(Ints{}).substr(0, 4);
+        REQUIRE(fromBinary<Ints>(ints + "\x02\x02\x04"s) == Ints{1, 2});
+        REQUIRE_THROWS_AS(fromBinary<Ints>(ints + "\x03\x02\x04"s), BinaryError);
+        REQUIRE_THROWS_AS(fromBinary<Ints>(ints + "\xff\xff\xff\xff\x0f\x02"s),
+                          BinaryError);
+
+        using Hobbies = std::vector<Hobby>;
+        auto const hobbies = toBinary(Hobbies{}).substr(0, 4);
+        REQUIRE_THROWS_AS(fromBinary<Hobbies>(hobbies + "\x02\x02\x00"s), BinaryError);
+
+        using Scores = std::map<std::string, int>;
+        auto const scores = toBinary(Scores{}).substr(0, 4);
+        REQUIRE(fromBinary<Scores>(scores + "\x01\x00\x02"s) == Scores{{"", 1}});
+        REQUIRE_THROWS_AS(fromBinary<Scores>(scores + "\x02\x00\x02\x00"s),
+                          BinaryError);
+    }
+}
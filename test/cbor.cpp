@@ -0,0 +1,188 @@
+/*
+  MIT License
+
+  Copyright (c) 2018 Nicolai Trandafil
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+// tested
+#include <serialize/cbor.hpp>
+#include <serialize/variant.hpp>
+
+// 3rd
+#include <catch2/catch.hpp>
+
+// std
+#include <limits>
+#include <string>
+
+
+using namespace serialize;
+
+
+namespace {
+
+
+std::string bytes(std::initializer_list<unsigned char> x) {
+    return std::string(x.begin(), x.end());
+}
+
+
+/// Remembers where the received strings point to
+struct Views {
+    bool Null() { return true; }
+    bool Bool(bool) { return true; }
+    bool Int64(std::int64_t) { return true; }
+    bool Uint64(std::uint64_t) { return true; }
+    bool Double(double) { return true; }
+    bool String(std::string_view x) { views.push_back(x); return true; }
+    bool Bytes(std::string_view x) { views.push_back(x); return true; }
+    bool StartArray(std::size_t) { return true; }
+    bool EndArray() { return true; }
+    bool StartObject(std::size_t) { return true; }
+    bool Key(std::string_view x) { views.push_back(x); return true; }
+    bool EndObject() { return true; }
+
+    std::vector<std::string_view> views;
+};
+
+
+} // namespace
+
+
+TEST_CASE("Check CBOR", "[cbor]") {
+    SECTION("RFC 8949 examples") {
+        REQUIRE(Variant(0).toCbor() == bytes({0x00}));
+        REQUIRE(Variant(24).toCbor() == bytes({0x18, 0x18}));
+        REQUIRE(Variant(-1).toCbor() == bytes({0x20}));
+        REQUIRE(Variant(1000000).toCbor() == bytes({0x1a, 0x00, 0x0f, 0x42, 0x40}));
+        REQUIRE(Variant("a").toCbor() == bytes({0x61, 0x61}));
+        REQUIRE(Variant(1.5).toCbor() == bytes({0xfa, 0x3f, 0xc0, 0x00, 0x00}));
+        REQUIRE(Variant(1.1).toCbor() ==
+                bytes({0xfb, 0x3f, 0xf1, 0x99, 0x99, 0x99, 0x99, 0x99, 0x9a}));
+        REQUIRE(Variant(std::numeric_limits<double>::infinity()).toCbor() ==
+                bytes({0xfa, 0x7f, 0x80, 0x00, 0x00}));
+
+        REQUIRE(Variant::fromCbor(bytes({0xf9, 0x3c, 0x00})) == Variant(1.0));
+        REQUIRE(Variant::fromCbor(bytes({0xf9, 0xc4, 0x00})) == Variant(-4.0));
+        REQUIRE(Variant::fromCbor(bytes({0x3b, 0x7f, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff})) ==
+                Variant(std::numeric_limits<long>::min()));
+        REQUIRE(Variant::fromCbor(bytes({0x1b, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff})) ==
+                Variant(std::numeric_limits<unsigned long>::max()));
+        REQUIRE(Variant::fromCbor(bytes({0xf6})) == Variant());
+        REQUIRE(Variant::fromCbor(bytes({0xf5})) == Variant(true));
+    }
+
+    SECTION("indefinite-length items") {
+        auto const expected = Variant(Variant::Vec{
+            Variant(1),
+            Variant(Variant::Vec{Variant(2), Variant(3)}),
+            Variant(Variant::Vec{Variant(4), Variant(5)})});
+
+        REQUIRE(Variant::fromCbor(bytes({0x9f, 0x01, 0x82, 0x02, 0x03, 0x9f,
+                                         0x04, 0x05, 0xff, 0xff})) == expected);
+
+        REQUIRE(Variant::fromCbor(bytes({0xbf, 0x61, 0x61, 0x01, 0x61, 0x62,
+                                         0x9f, 0x02, 0x03, 0xff, 0xff})) ==
+                Variant(Variant::Map{
+                    {"a", Variant(1)},
+                    {"b", Variant(Variant::Vec{Variant(2), Variant(3)})}}));
+
+        REQUIRE(Variant::fromCbor(bytes({0x7f, 0x65, 0x73, 0x74, 0x72, 0x65,
+                                         0x61, 0x64, 0x6d, 0x69, 0x6e, 0x67,
+                                         0xff})) == Variant("streaming"));
+    }
+
+    SECTION("streaming writer") {
+        std::string out;
+        cbor::Writer writer(out);
+        writer.StartArray();
+        for (int i = 0; i < 3; ++i) {
+            Variant(Variant::Map{{"i", Variant(i)}}).to(writer);
+        }
+        writer.EndArray();
+
+        REQUIRE(out.front() == char(0x9f));
+        REQUIRE(out.back() == char(0xff));
+        REQUIRE(Variant::fromCbor(out) == Variant(Variant::Vec{
+            Variant(Variant::Map{{"i", Variant(0)}}),
+            Variant(Variant::Map{{"i", Variant(1)}}),
+            Variant(Variant::Map{{"i", Variant(2)}})}));
+    }
+
+    SECTION("round trip matches JSON") {
+        auto const json = R"({"x": 6, "y": [1, -2, 4294967295, 1.25], "z": {"a": "b", "n": null, "t": true}})";
+        auto const var = Variant::fromJson(json);
+        REQUIRE(Variant::fromCbor(var.toCbor()) == var);
+    }
+
+    SECTION("doubles beyond the range of float") {
+        for (auto const x: {1e300, -1e300, 1e39,
+                            double(std::numeric_limits<float>::max()) * 2}) {
+            auto const data = Variant(x).toCbor();
+            REQUIRE(data.size() == 9);
+            REQUIRE(Variant::fromCbor(data) == Variant(x));
+        }
+        auto const max = double(std::numeric_limits<float>::max());
+        REQUIRE(Variant(max).toCbor().size() == 5);
+        REQUIRE(Variant::fromCbor(Variant(-max).toCbor()) == Variant(-max));
+    }
+
+    SECTION("strings are views into the input") {
+        auto const data = Variant(Variant::Map{{"key", Variant("value")}}).toCbor();
+        Views views;
+        cbor::Reader reader(data);
+        REQUIRE(reader.parse(views) == data.size());
+        REQUIRE(views.views.size() == 2);
+        for (auto const& x: views.views) {
+            REQUIRE(x.data() >= data.data());
+            REQUIRE(x.data() + x.size() <= data.data() + data.size());
+        }
+    }
+
+    SECTION("byte strings") {
+        std::string out;
+        cbor::Writer writer(out);
+        writer.Bytes(bytes({0x00, 0xff}));
+        REQUIRE(Variant::fromCbor(out) == Variant(bytes({0x00, 0xff})));
+    }
+
+    SECTION("malformed input") {
+        REQUIRE_THROWS_AS(Variant::fromCbor(bytes({0x82, 0x01})), cbor::CborError);
+        REQUIRE_THROWS_AS(Variant::fromCbor(bytes({0x01, 0x01})), cbor::CborError);
+        REQUIRE_THROWS_AS(Variant::fromCbor(bytes({0xff})), cbor::CborError);
+        REQUIRE_THROWS_AS(Variant::fromCbor(bytes({0x9b, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff})),
+                          cbor::CborError);
+        REQUIRE_THROWS_AS(Variant::fromCbor(bytes({0xa1, 0x01, 0x01})), cbor::CborError);
+        REQUIRE_THROWS_AS(Variant::fromCbor(bytes({0x9f, 0x01})), cbor::CborError);
+    }
+
+    SECTION("nested size hints") {
+        // every header announces the whole rest of the input
+        std::string data;
+        for (std::uint32_t i = 16000; i != 0; --i) {
+            auto const left = 5 * (i - 1);
+            data += bytes({0x9a, std::uint8_t(left >> 24), std::uint8_t(left >> 16),
+                           std::uint8_t(left >> 8), std::uint8_t(left)});
+        }
+        REQUIRE_THROWS_AS(Variant::fromCbor(data), cbor::CborError);
+    }
+}
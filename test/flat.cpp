@@ -0,0 +1,178 @@
+/*
+  MIT License
+
+  Copyright (c) 2018 Nicolai Trandafil
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+// tested
+#include <serialize/flat.hpp>
+
+// local
+#include <serialize/comparison_traits.hpp>
+#include <serialize/variant_traits.hpp>
+
+// 3rd
+#include <catch2/catch.hpp>
+
+// boost
+#include <boost/hana.hpp>
+
+// std
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+namespace hana = boost::hana;
+
+
+using namespace serialize;
+
+
+using namespace hana::literals;
+
+
+namespace {
+
+
+struct Airport
+        : trait::Var<Airport>
+        , trait::EqualityComparison<Airport> {
+    std::string code;
+    double lat{0};
+    std::optional<int> elevation;
+    std::vector<std::string> runways;
+};
+
+
+struct Table
+        : trait::Var<Table>
+        , trait::EqualityComparison<Table> {
+    int version{0};
+    Airport hub;
+    std::vector<Airport> airports;
+    std::map<std::string, int> index;
+    std::unordered_map<int, std::string> names;
+    std::vector<unsigned short> ids;
+};
+
+
+Airport airport(std::string const& code,
+                double lat,
+                std::optional<int> elevation,
+                std::vector<std::string> const& runways) {
+    Airport ret;
+    ret.code = code;
+    ret.lat = lat;
+    ret.elevation = elevation;
+    ret.runways = runways;
+    return ret;
+}
+
+
+} // namespace
+
+
+BOOST_HANA_ADAPT_STRUCT(Airport, code, lat, elevation, runways);
+BOOST_HANA_ADAPT_STRUCT(Table, version, hub, airports, index, names, ids);
+
+
+TEST_CASE("Check flat layout", "[flat]") {
+    Table table;
+    table.version = 7;
+    table.hub = airport("KIV", 46.93, 122, {"08/26"});
+    table.airports = {
+        airport("OTP", 44.57, std::nullopt, {"08L/26R", "08R/26L"}),
+        airport("LHR", 51.47, 25, {})
+    };
+    table.index = {{"OTP", 0}, {"LHR", 1}, {"KIV", 2}};
+    table.names = {{2, "Chisinau"}, {0, "Otopeni"}};
+    table.ids = {1, 2, 65535};
+
+    auto const buf = flat::build(table);
+    auto const view = flat::view<Table>(buf);
+
+    SECTION("scalars, strings and nested structs") {
+        REQUIRE(view["version"_s] == 7);
+        REQUIRE(view["hub"_s]["code"_s] == "KIV");
+        REQUIRE(view["hub"_s]["lat"_s] == 46.93);
+        REQUIRE(view["hub"_s]["elevation"_s] == 122);
+        REQUIRE(view["hub"_s]["runways"_s][0] == "08/26");
+    }
+
+    SECTION("vectors") {
+        auto const airports = view["airports"_s];
+        REQUIRE(airports.size() == 2);
+        REQUIRE(airports[0]["code"_s] == "OTP");
+        REQUIRE_FALSE(airports[0]["elevation"_s].has_value());
+        REQUIRE(airports[0]["runways"_s].size() == 2);
+        REQUIRE(airports[0]["runways"_s][1] == "08R/26L");
+        REQUIRE(airports[1]["elevation"_s] == 25);
+        REQUIRE(airports[1]["runways"_s].empty());
+
+        std::vector<unsigned short> ids;
+        for (auto x: view["ids"_s]) { ids.push_back(x); }
+        REQUIRE(ids == table.ids);
+    }
+
+    SECTION("maps") {
+        auto const index = view["index"_s];
+        REQUIRE(index.size() == 3);
+        REQUIRE(index.key(0) == "KIV");
+        REQUIRE(index.find("LHR") == 1);
+        REQUIRE(index.find("OTP") == 0);
+        REQUIRE_FALSE(index.find("JFK").has_value());
+        REQUIRE(view["names"_s].find(2) == std::optional<std::string_view>("Chisinau"));
+    }
+
+    SECTION("strings point into the buffer") {
+        auto const code = view["airports"_s][1]["code"_s];
+        REQUIRE(code.data() > buf.data());
+        REQUIRE(code.data() < buf.data() + buf.size());
+    }
+
+    SECTION("load") {
+        REQUIRE(view.load() == table);
+    }
+
+    SECTION("memory mapped file") {
+        auto const path = "serialize_flat_test.bin";
+        std::ofstream(path, std::ios::binary) << buf;
+        {
+            flat::MappedFile file(path);
+            auto const mapped = flat::view<Table>(file.data());
+            REQUIRE(mapped["airports"_s][0]["runways"_s][0] == "08L/26R");
+            REQUIRE(mapped.load() == table);
+        }
+        std::remove(path);
+        REQUIRE_THROWS_AS(flat::MappedFile(path), std::system_error);
+    }
+
+    SECTION("schema mismatch") {
+        REQUIRE_THROWS_AS(flat::view<Airport>(buf), flat::FlatError);
+        REQUIRE_THROWS_AS(flat::view<Table>(buf.substr(0, 10)), flat::FlatError);
+    }
+}
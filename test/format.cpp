@@ -0,0 +1,175 @@
+/*
+  MIT License
+
+  Copyright (c) 2018 Nicolai Trandafil
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+// tested
+#include <serialize/format.hpp>
+
+// local
+#include <serialize/ostream_traits.hpp>
+#include <serialize/variant.hpp>
+
+// 3rd
+#include <catch2/catch.hpp>
+
+// std
+#include <iomanip>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+
+using namespace serialize;
+
+
+namespace {
+
+
+template <typename T>
+std::string streamed(T const& x) {
+    std::ostringstream os;
+    os << x;
+    return os.str();
+}
+
+
+template <typename T>
+std::string appended(T const& x) {
+    std::string ret;
+    appendTo(ret, x);
+    return ret;
+}
+
+
+struct Point
+        : trait::OStream<Point> {
+    double x;
+    double y;
+};
+
+
+struct Shape
+        : trait::OStream<Shape> {
+    std::string name;
+    char tag;
+    std::optional<long> id;
+    std::vector<Point> points;
+    std::map<std::string, unsigned> counts;
+};
+
+
+} // namespace
+
+
+BOOST_HANA_ADAPT_STRUCT(Point, x, y);
+BOOST_HANA_ADAPT_STRUCT(Shape, name, tag, id, points, counts);
+
+
+TEST_CASE("Check appendTo", "[format]") {
+    SECTION("numbers as streamed") {
+        for (auto const x: {0.0, -0.0, 1.0, 2.5, 1e-7, 123456789.0, 1e300,
+                            std::numeric_limits<double>::infinity()}) {
+            REQUIRE(appended(x) == streamed(x));
+        }
+        REQUIRE(appended(2.5f) == streamed(2.5f));
+        REQUIRE(appended(std::numeric_limits<long>::min()) ==
+                streamed(std::numeric_limits<long>::min()));
+        REQUIRE(appended(std::numeric_limits<unsigned long>::max()) ==
+                streamed(std::numeric_limits<unsigned long>::max()));
+        REQUIRE(appended(short(-3)) == "-3");
+        REQUIRE(appended(true) == "1");
+        REQUIRE(appended('a') == "a");
+        REQUIRE(appended("text") == "text");
+        REQUIRE(appended(std::string("text")) == "text");
+    }
+
+    SECTION("appends") {
+        std::string out = "x = ";
+        appendTo(out, 42);
+        REQUIRE(out == "x = 42");
+    }
+
+    SECTION("output iterator") {
+        std::vector<char> out;
+        formatTo(std::back_inserter(out), 1.5);
+        REQUIRE(std::string(out.begin(), out.end()) == "1.5");
+    }
+
+    SECTION("trait::OStream") {
+        Shape x;
+        x.name = "box";
+        x.tag = 'b';
+        x.id = 7;
+        x.points = {Point{{}, 0, 0.5}, Point{{}, 1e10, -1}};
+        x.counts = {{"corners", 4}};
+
+        auto const expected = "Shape { name: box; tag: b; id: 7; "
+                              "points: [Point { x: 0; y: 0.5; }, "
+                              "Point { x: 1e+10; y: -1; }]; "
+                              "counts: { corners: 4; }; }";
+        REQUIRE(appended(x) == expected);
+        REQUIRE(streamed(x) == expected);
+
+        x.id.reset();
+        REQUIRE(appended(x).find("id") == std::string::npos);
+    }
+
+    SECTION("trait::OStream honours the stream state") {
+        Point const p{{}, 3.14159265358, 255};
+
+        std::ostringstream os;
+        os << std::setprecision(12) << p;
+        REQUIRE(os.str() == "Point { x: 3.14159265358; y: 255; }");
+
+        os.str("");
+        os << std::fixed << std::setprecision(2) << p;
+        REQUIRE(os.str() == "Point { x: 3.14; y: 255.00; }");
+
+        os.str("");
+        os.copyfmt(std::ostringstream());
+        os << std::setw(7) << p << p;
+        REQUIRE(os.str() == "  Point { x: 3.14159; y: 255; }"
+                            "Point { x: 3.14159; y: 255; }");
+    }
+
+    SECTION("Variant") {
+        Variant const var(Variant::Map{
+            {"a", Variant(Variant::Vec{Variant(1), Variant(-2L), Variant(true)})},
+            {"b", Variant(2.5)},
+            {"c", Variant(std::numeric_limits<unsigned long>::max())},
+            {"d", Variant()}
+        });
+
+        auto const expected = "{ a: [ 1, -2, 1 ]; b: 2.500000; "
+                              "c: 18446744073709551615; d: Null; }";
+        REQUIRE(appended(var) == expected);
+        REQUIRE(streamed(var) == expected);
+        REQUIRE(appended(Variant(1e300)) == std::to_string(1e300));
+        REQUIRE(appended(Variant(-1e-9)) == std::to_string(-1e-9));
+    }
+}
@@ -0,0 +1,118 @@
+/*
+  MIT License
+
+  Copyright (c) 2018 Nicolai Trandafil
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+// tested
+#include <serialize/node_pool.hpp>
+
+// local
+#include <serialize/variant.hpp>
+
+// 3rd
+#include <catch2/catch.hpp>
+
+// std
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+using namespace serialize;
+
+
+TEST_CASE("Check NodePool", "[node_pool]") {
+    NodePool::trim();
+    REQUIRE(NodePool::cached() == 0);
+
+    SECTION("same thread") {
+        {
+            std::vector<Variant> xs(100, Variant(1));
+        }
+        REQUIRE(NodePool::cached() == 101);
+        Variant const y(2);
+        REQUIRE(NodePool::cached() == 100);
+    }
+
+    SECTION("freed by another thread") {
+        std::vector<Variant> xs;
+        for (int i = 0; i < 100; ++i) { xs.emplace_back(i); }
+        std::thread([&] { xs.clear(); }).join();
+        REQUIRE(NodePool::cached() == 0);
+
+        // takes the blocks back
+        Variant const y(1);
+        REQUIRE(NodePool::cached() == 99);
+    }
+
+    SECTION("exited threads") {
+        std::vector<Variant> xs;
+        std::thread([&] {
+            for (int i = 0; i < 100; ++i) { xs.emplace_back(i); }
+        }).join();
+        xs.clear();
+        REQUIRE(NodePool::cached() == 0);
+
+        std::thread([] {
+            Variant const y(1);
+            REQUIRE(y.integer() == 1);
+        }).join();
+    }
+
+    SECTION("producers and consumers") {
+        std::mutex mutex;
+        std::vector<Variant> queue;
+        std::atomic<int> consumed{0};
+        int const n = 10000;
+
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 2; ++t) {
+            threads.emplace_back([&] {
+                for (int i = 0; i < n; ++i) {
+                    Variant x(Variant::Vec{Variant(i), Variant("x")});
+                    std::lock_guard<std::mutex> lock(mutex);
+                    queue.push_back(std::move(x));
+                }
+            });
+            threads.emplace_back([&] {
+                while (consumed < 2 * n) {
+                    std::vector<Variant> batch;
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        batch.swap(queue);
+                    }
+                    consumed += static_cast<int>(batch.size());
+                }
+            });
+        }
+        for (auto& t: threads) { t.join(); }
+        REQUIRE(consumed == 2 * n);
+    }
+
+    SECTION("large blocks") {
+        auto const p = NodePool::allocate(NodePool::max_size + 1);
+        NodePool::deallocate(p, NodePool::max_size + 1);
+        REQUIRE(NodePool::cached() == 0);
+    }
+}
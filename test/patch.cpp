@@ -0,0 +1,261 @@
+/*
+  MIT License
+
+  Copyright (c) 2018 Nicolai Trandafil
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+// tested
+#include <serialize/patch.hpp>
+
+// local
+#include <serialize/variant.hpp>
+
+// 3rd
+#include <catch2/catch.hpp>
+
+// std
+#include <string>
+
+
+using namespace serialize;
+
+
+namespace {
+
+
+Variant json(std::string const& x) { return Variant::fromJson(x); }
+
+
+} // namespace
+
+
+TEST_CASE("Check JSON Patch", "[patch]") {
+    auto const a = json(R"({
+        "name": "config",
+        "limits": {"cpu": 2, "memory": 512, "disk": 10},
+        "hosts": ["a", "b", "c", "d"],
+        "nested": {"deep": {"deeper": [1, 2, 3]}}
+    })");
+
+    SECTION("diff") {
+        REQUIRE(diff(a, a).vec().empty());
+
+        auto b = a;
+        auto& limits = b.mapMut().at("limits").mapMut();
+        limits.at("cpu") = Variant(4);
+        limits.erase("disk");
+        limits.emplace("swap", Variant(0));
+
+        REQUIRE(diff(a, b) == json(R"([
+            {"op": "remove", "path": "/limits/disk"},
+            {"op": "replace", "path": "/limits/cpu", "value": 4},
+            {"op": "add", "path": "/limits/swap", "value": 0}
+        ])"));
+    }
+
+    SECTION("vectors") {
+        auto const b = json(R"(["a", "x", "c", "d", "e"])");
+        auto const c = json(R"(["a", "d"])");
+        auto const d = json(R"(["z", "a", "b", "c", "d"])");
+        auto const hosts = a.map().at("hosts");
+
+        REQUIRE(diff(hosts, b) == json(R"([
+            {"op": "replace", "path": "/1", "value": "x"},
+            {"op": "add", "path": "/4", "value": "e"}
+        ])"));
+
+        for (auto const& target: {b, c, d}) {
+            auto x = hosts;
+            applyPatch(x, diff(hosts, target));
+            REQUIRE(x == target);
+        }
+    }
+
+    SECTION("round trip") {
+        auto const b = json(R"({
+            "name": "config/2",
+            "limits": {"cpu": 2, "memory": "512M"},
+            "hosts": ["b", "c"],
+            "nested": {"deep": {"deeper": [1, 2, 3, 4]}, "new~key": null}
+        })");
+
+        auto x = a;
+        applyPatch(x, diff(a, b));
+        REQUIRE(x == b);
+
+        x = b;
+        applyPatch(x, diff(b, a));
+        REQUIRE(x == a);
+
+        x = a;
+        applyPatch(x, diff(a, Variant(1)));
+        REQUIRE(x == Variant(1));
+    }
+
+    SECTION("operations") {
+        auto x = a;
+        applyPatch(x, json(R"([
+            {"op": "test", "path": "/hosts/1", "value": "b"},
+            {"op": "add", "path": "/hosts/-", "value": "e"},
+            {"op": "add", "path": "/hosts/0", "value": "z"},
+            {"op": "remove", "path": "/hosts/1"},
+            {"op": "move", "from": "/limits/cpu", "path": "/cpu"},
+            {"op": "copy", "from": "/nested/deep", "path": "/limits/deep"},
+            {"op": "replace", "path": "/name", "value": "patched"}
+        ])"));
+
+        REQUIRE(x == json(R"({
+            "name": "patched",
+            "cpu": 2,
+            "limits": {"memory": 512, "disk": 10, "deep": {"deeper": [1, 2, 3]}},
+            "hosts": ["z", "b", "c", "d", "e"],
+            "nested": {"deep": {"deeper": [1, 2, 3]}}
+        })"));
+
+        REQUIRE_THROWS_WITH(applyPatch(x, json(R"([
+            {"op": "test", "path": "/name", "value": "config"}])")),
+            "Patch: test failed at '/name'");
+        REQUIRE_THROWS_AS(applyPatch(x, json(R"([
+            {"op": "remove", "path": "/missing"}])")), PatchError);
+        REQUIRE_THROWS_AS(applyPatch(x, json(R"([
+            {"op": "add", "path": "/hosts/9", "value": 1}])")), PatchError);
+        REQUIRE_THROWS_AS(applyPatch(x, json(R"([
+            {"op": "move", "from": "/nested", "path": "/nested/deep/x"}])")),
+            PatchError);
+        REQUIRE_THROWS_AS(applyPatch(x, json(R"([
+            {"op": "add", "path": "/missing/x", "value": 1}])")), PatchError);
+        REQUIRE_THROWS_AS(applyPatch(x, json(R"([{"op": "flip", "path": ""}])")),
+                          PatchError);
+        REQUIRE_THROWS_AS(applyPatch(x, json(R"([{"path": ""}])")), PatchError);
+    }
+
+    SECTION("moved patch") {
+        auto const b = json(R"({"name": "other", "hosts": [[1, 2], [3]]})");
+        auto x = a;
+        applyPatch(x, diff(a, b));
+        REQUIRE(x == b);
+    }
+
+    SECTION("references kept across a diff") {
+        auto x = a;
+        auto& deep = x["nested"]["deep"];
+        REQUIRE(diff(x, a).vec().empty());
+        deep["deeper"] = Variant(1);
+        REQUIRE(x != a);
+        REQUIRE(diff(x, a) == json(R"([{"op": "replace",
+            "path": "/nested/deep/deeper", "value": [1, 2, 3]}])"));
+    }
+}
+
+
+TEST_CASE("Check JSON Merge Patch", "[patch]") {
+    // RFC 7386 appendix A
+    auto x = json(R"({"title": "Goodbye!",
+        "author": {"givenName": "John", "familyName": "Doe"},
+        "tags": ["example", "sample"], "content": "This will be unchanged"})");
+    auto const patch = json(R"({"title": "Hello!", "phoneNumber": "+01-123-456-7890",
+        "author": {"familyName": null}, "tags": ["example"]})");
+    auto const expected = json(R"({"title": "Hello!",
+        "author": {"givenName": "John"}, "tags": ["example"],
+        "content": "This will be unchanged", "phoneNumber": "+01-123-456-7890"})");
+
+    auto y = x;
+    applyMergePatch(y, patch);
+    REQUIRE(y == expected);
+
+    REQUIRE(mergeDiff(x, expected) == patch);
+
+    applyMergePatch(x, mergeDiff(x, expected));
+    REQUIRE(x == expected);
+
+    REQUIRE(mergeDiff(x, x) == Variant(Variant::Map{}));
+
+    Variant z(1);
+    applyMergePatch(z, json(R"({"a": {"b": 1}})"));
+    REQUIRE(z == json(R"({"a": {"b": 1}})"));
+}
+
+
+TEST_CASE("Check merge", "[patch]") {
+    auto const defaults = json(R"({
+        "name": "service",
+        "hosts": ["a"],
+        "limits": {"cpu": 1, "memory": 256},
+        "debug": false
+    })");
+    auto const site = json(R"({
+        "hosts": ["b", "c"],
+        "limits": {"memory": 512, "swap": null},
+        "debug": null
+    })");
+
+    SECTION("replace") {
+        auto x = defaults;
+        merge(x, site);
+        REQUIRE(x == json(R"({
+            "name": "service",
+            "hosts": ["b", "c"],
+            "limits": {"cpu": 1, "memory": 512}
+        })"));
+
+        auto y = defaults;
+        applyMergePatch(y, site);
+        REQUIRE(x == y);
+    }
+
+    SECTION("concat") {
+        auto x = defaults;
+        merge(x, site, {MergePolicy::Arrays::concat, MergePolicy::Nulls::skip});
+        REQUIRE(x == json(R"({
+            "name": "service",
+            "hosts": ["a", "b", "c"],
+            "limits": {"cpu": 1, "memory": 512},
+            "debug": false
+        })"));
+    }
+
+    SECTION("assign nulls") {
+        auto x = defaults;
+        merge(x, site, {MergePolicy::Arrays::replace, MergePolicy::Nulls::assign});
+        REQUIRE(x == json(R"({
+            "name": "service",
+            "hosts": ["b", "c"],
+            "limits": {"cpu": 1, "memory": 512, "swap": null},
+            "debug": null
+        })"));
+    }
+
+    SECTION("layers") {
+        auto x = defaults;
+        for (auto layer: {site, json(R"({"limits": {"cpu": 4}})")}) {
+            merge(x, std::move(layer));
+        }
+        REQUIRE(x.map().at("limits") == json(R"({"cpu": 4, "memory": 512})"));
+
+        Variant y(1);
+        merge(y, json(R"({"a": [1, null]})"));
+        REQUIRE(y == json(R"({"a": [1, null]})"));
+
+        merge(y, Variant(), {MergePolicy::Arrays::replace, MergePolicy::Nulls::skip});
+        REQUIRE(y == json(R"({"a": [1, null]})"));
+    }
+}
@@ -0,0 +1,115 @@
+/*
+  MIT License
+
+  Copyright (c) 2018 Nicolai Trandafil
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+// tested
+#include <serialize/path.hpp>
+
+// local
+#include <serialize/variant.hpp>
+
+// 3rd
+#include <catch2/catch.hpp>
+
+// std
+#include <string>
+#include <vector>
+
+
+using namespace serialize;
+
+
+TEST_CASE("Check Path", "[path]") {
+    Variant const var(Variant::Map{
+        {"name", Variant("track")},
+        {"points", Variant(Variant::Vec{
+            Variant(Variant::Map{{"x", Variant(1)}, {"y", Variant(2)}}),
+            Variant(Variant::Map{{"x", Variant(3)}, {"y", Variant(4)}})
+        })},
+        {"a/b", Variant(Variant::Map{{"m~n", Variant(5)}, {"0", Variant(6)}})}
+    });
+
+    SECTION("pointer") {
+        REQUIRE(var.at(Path::pointer("/points/1/x")).integer() == 3);
+        REQUIRE(var.at(Path::pointer("/a~1b/m~0n")).integer() == 5);
+        REQUIRE(var.at(Path::pointer("/a~1b/0")).integer() == 6);
+        REQUIRE(&var.at(Path::pointer("")) == &var);
+        REQUIRE(Path::pointer("/a~1b/m~0n").str() == "/a~1b/m~0n");
+
+        REQUIRE(var.find(Path::pointer("/points/2/x")) == nullptr);
+        REQUIRE(var.find(Path::pointer("/points/01")) == nullptr);
+        REQUIRE(var.find(Path::pointer("/points/-")) == nullptr);
+        REQUIRE(var.find(Path::pointer("/name/x")) == nullptr);
+        REQUIRE(var.find(Path::pointer("/")) == nullptr);
+
+        REQUIRE_THROWS_AS(Path::pointer("points"), PathError);
+        REQUIRE_THROWS_AS(Path::pointer("/a~2"), PathError);
+        REQUIRE_THROWS_WITH(var.at(Path::pointer("/nope")),
+                            "Path: no value at '/nope'");
+    }
+
+    SECTION("dotted") {
+        REQUIRE(Path::dotted("points[1].x") == Path::pointer("/points/1/x"));
+        REQUIRE(Path::dotted("points.1.x") == Path::pointer("/points/1/x"));
+        REQUIRE(Path::dotted("[0]") == Path::pointer("/0"));
+        REQUIRE(Path::dotted("") == Path());
+        REQUIRE(var.at(Path::dotted("points[0].y")).integer() == 2);
+
+        REQUIRE_THROWS_AS(Path::dotted("points..x"), PathError);
+        REQUIRE_THROWS_AS(Path::dotted("points."), PathError);
+        REQUIRE_THROWS_AS(Path::dotted(".points"), PathError);
+        REQUIRE_THROWS_AS(Path::dotted("points[x]"), PathError);
+        REQUIRE_THROWS_AS(Path::dotted("points[1"), PathError);
+        REQUIRE_THROWS_AS(Path::dotted("points[1]x"), PathError);
+    }
+
+    SECTION("set") {
+        PathSet const set({
+            Path::dotted("points[1].x"),
+            Path::dotted("points[1].y"),
+            Path::dotted("points[1].z"),
+            Path::dotted("points[0]"),
+            Path::dotted("name"),
+            Path::dotted("points[1].x"),
+            Path()
+        });
+        REQUIRE(set.size() == 7);
+
+        auto const values = set.extract(var);
+        REQUIRE(values.size() == 7);
+        REQUIRE(values[0]->integer() == 3);
+        REQUIRE(values[1]->integer() == 4);
+        REQUIRE(values[2] == nullptr);
+        REQUIRE(values[3] == &var.map().at("points").vec()[0]);
+        REQUIRE(values[4]->str() == "track");
+        REQUIRE(values[5] == values[0]);
+        REQUIRE(values[6] == &var);
+
+        std::vector<Variant const*> out;
+        set.extract(Variant(1), out);
+        REQUIRE(out == std::vector<Variant const*>{
+            nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, out[6]});
+        REQUIRE(out[6] != nullptr);
+    }
+}
@@ -0,0 +1,208 @@
+/*
+  MIT License
+
+  Copyright (c) 2018 Nicolai Trandafil
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+// tested
+#include <serialize/protobuf.hpp>
+
+// local
+#include <serialize/comparison_traits.hpp>
+#include <serialize/variant_traits.hpp>
+
+// 3rd
+#include <catch2/catch.hpp>
+
+// boost
+#include <boost/hana.hpp>
+
+// std
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+
+namespace hana = boost::hana;
+
+
+using namespace serialize;
+
+
+using namespace hana::literals;
+using namespace std::literals;
+
+
+namespace {
+
+
+struct Test1 : trait::EqualityComparison<Test1> {
+    int a{0};
+};
+
+
+struct Test2 : trait::EqualityComparison<Test2> {
+    static auto fieldNumbers() {
+        return hana::make_map(hana::make_pair("b"_s, hana::int_c<2>));
+    }
+
+    std::string b;
+};
+
+
+struct Test3 : trait::EqualityComparison<Test3> {
+    static auto fieldNumbers() {
+        return hana::make_map(
+            hana::make_pair("c"_s, hana::int_c<3>),
+            hana::make_pair("d"_s, hana::int_c<4>));
+    }
+
+    Test1 c;
+    std::vector<int> d;
+};
+
+
+enum class Kind { none, user, admin };
+
+
+struct Account
+        : trait::Var<Account>
+        , trait::EqualityComparison<Account> {
+    std::string name;
+    long balance{0};
+    std::optional<int> age;
+    bool active{false};
+    double score{0};
+    float ratio{0};
+    Kind kind{Kind::none};
+    std::vector<std::string> tags;
+    std::vector<std::uint64_t> ids;
+    std::map<std::string, Test1> groups;
+    std::optional<Test1> extra;
+    Variant meta;
+    int level{3};
+};
+
+
+struct Nested : trait::EqualityComparison<Nested> {
+    std::vector<std::vector<int>> v;
+    int after{0};
+};
+
+
+} // namespace
+
+
+BOOST_HANA_ADAPT_STRUCT(Test1, a);
+BOOST_HANA_ADAPT_STRUCT(Test2, b);
+BOOST_HANA_ADAPT_STRUCT(Test3, c, d);
+BOOST_HANA_ADAPT_STRUCT(Account, name, balance, age, active, score, ratio,
+                        kind, tags, ids, groups, extra, meta, level);
+BOOST_HANA_ADAPT_STRUCT(Nested, v, after);
+
+
+TEST_CASE("Check protobuf", "[protobuf]") {
+    SECTION("encoding guide vectors") {
+        Test1 t1;
+        t1.a = 150;
+        REQUIRE(toProtobuf(t1) == "\x08\x96\x01"s);
+        REQUIRE(fromProtobuf<Test1>("\x08\x96\x01"s) == t1);
+
+        Test2 t2;
+        t2.b = "testing";
+        REQUIRE(toProtobuf(t2) == "\x12\x07testing"s);
+        REQUIRE(fromProtobuf<Test2>("\x12\x07testing"s) == t2);
+
+        Test3 t3;
+        t3.c = t1;
+        t3.d = {3, 270, 86942};
+        auto const data = "\x1a\x03\x08\x96\x01\x22\x06\x03\x8e\x02\x9e\xa7\x05"s;
+        REQUIRE(toProtobuf(t3) == data);
+        REQUIRE(fromProtobuf<Test3>(data) == t3);
+    }
+
+    SECTION("negative int is sign extended") {
+        Test1 t;
+        t.a = -1;
+        auto const data = toProtobuf(t);
+        REQUIRE(data == "\x08\xff\xff\xff\xff\xff\xff\xff\xff\xff\x01"s);
+        REQUIRE(fromProtobuf<Test1>(data).a == -1);
+    }
+
+    SECTION("unpacked repeated and unknown fields are accepted") {
+        auto const data = "\x20\x03\x28\x07\x20\x04\x32\x01x"s;
+        REQUIRE(fromProtobuf<Test3>(data).d == std::vector<int>{3, 4});
+    }
+
+    SECTION("zero fields are skipped") {
+        Test3 t;
+        REQUIRE(toProtobuf(t.c).empty());
+        REQUIRE(toProtobuf(t) == "\x1a\x00"s);
+    }
+
+    SECTION("round trip") {
+        Account x;
+        x.name = "Efendi";
+        x.balance = -20;
+        x.age = 0;
+        x.active = true;
+        x.score = 1.5;
+        x.ratio = 0.25f;
+        x.kind = Kind::admin;
+        x.tags = {"a", "", "c"};
+        x.ids = {1, 0, UINT64_MAX};
+        x.groups["admins"].a = 1;
+        x.groups["users"];
+        x.extra.emplace();
+        x.meta = Variant(Variant::Vec{Variant(1), Variant("two")});
+        x.level = 0;
+
+        auto const data = toProtobuf(x);
+        REQUIRE(fromProtobuf<Account>(data) == x);
+
+        Account empty;
+        empty.level = 0;
+        REQUIRE(fromProtobuf<Account>("") == empty);
+    }
+
+    SECTION("nested containers are CBOR bytes") {
+        Nested x;
+        x.v = {{300, 300, 300}};
+        x.after = 7;
+
+        auto const cbor = toVariant(x.v[0]).toCbor();
+        auto const data = toProtobuf(x);
+        REQUIRE(data == "\x0a"s + char(cbor.size()) + cbor + "\x10\x07"s);
+        REQUIRE(fromProtobuf<Nested>(data) == x);
+    }
+
+    SECTION("malformed") {
+        REQUIRE_THROWS_AS(fromProtobuf<Test1>("\x08"s), BinaryError);
+        REQUIRE_THROWS_AS(fromProtobuf<Test1>("\x0a\x00"s), ProtobufError);
+        REQUIRE_THROWS_AS(fromProtobuf<Test1>("\x0b"s), ProtobufError);
+        REQUIRE_THROWS_AS(fromProtobuf<Test1>("\x00\x01"s), ProtobufError);
+        REQUIRE_THROWS_AS(
+            fromProtobuf<Test1>("\x08\x80\x80\x80\x80\x10"s), ProtobufError);
+    }
+}
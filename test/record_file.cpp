@@ -0,0 +1,152 @@
+/*
+  MIT License
+
+  Copyright (c) 2018 Nicolai Trandafil
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+// tested
+#include <serialize/record_file.hpp>
+
+// local
+#include <serialize/variant.hpp>
+
+// 3rd
+#include <catch2/catch.hpp>
+
+// std
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+
+using namespace serialize;
+
+
+namespace {
+
+
+std::vector<std::string> readAll(RecordReader const& reader, unsigned threads) {
+    std::vector<std::string> ret;
+    reader.forEach([&](std::string_view x) { ret.emplace_back(x); }, threads);
+    return ret;
+}
+
+
+} // namespace
+
+
+TEST_CASE("Check record file", "[record_file]") {
+    auto const path = "serialize_record_test.srec";
+
+    std::vector<std::string> records;
+    for (int i = 0; i < 500; ++i) {
+        Variant::Map map;
+        map["id"] = Variant(i);
+        map["name"] = Variant("record " + std::to_string(i));
+        map["tags"] = Variant(Variant::Vec{Variant("a"), Variant(i % 7 == 0)});
+        records.push_back(Variant(map).toCbor());
+    }
+    records.push_back("");
+
+    for (auto const codec: {Codec::none, Codec::lz4, Codec::zstd}) {
+        if (!codecSupported(codec)) {
+            REQUIRE_THROWS_AS(RecordWriter(path, {codec}), RecordFileError);
+            continue;
+        }
+
+        DYNAMIC_SECTION("codec " << static_cast<int>(codec)) {
+            {
+                RecordWriterOptions options;
+                options.codec = codec;
+                options.block_size = 1024;
+                RecordWriter writer(path, options);
+                for (auto const& x: records) { writer.append(x); }
+                writer.close();
+            }
+
+            RecordReader reader(path);
+            REQUIRE(reader.recordCount() == records.size());
+            REQUIRE(reader.blockCount() > 4);
+
+            REQUIRE(readAll(reader, 1) == records);
+            REQUIRE(readAll(reader, 3) == records);
+
+            auto const n = reader.blockOf(250);
+            auto const block = reader.block(n);
+            REQUIRE(block.first() <= 250);
+            REQUIRE(block.first() + block.size() > 250);
+            REQUIRE(block[250 - block.first()] == records[250]);
+            REQUIRE(Variant::fromCbor(block[250 - block.first()]).map().at("id").integer() == 250);
+
+            REQUIRE(reader.blockOf(0) == 0);
+            REQUIRE(reader.blockOf(records.size() - 1) == reader.blockCount() - 1);
+            REQUIRE_THROWS_AS(reader.blockOf(records.size()), std::out_of_range);
+
+            auto const blocks = reader.blocks(1, 3, 2);
+            REQUIRE(blocks.size() == 2);
+            REQUIRE(blocks[1].first() == blocks[0].first() + blocks[0].size());
+        }
+    }
+
+    SECTION("empty file") {
+        RecordWriter(path).close();
+        RecordReader reader(path);
+        REQUIRE(reader.recordCount() == 0);
+        REQUIRE(reader.blockCount() == 0);
+        REQUIRE(readAll(reader, 0).empty());
+    }
+
+    SECTION("corrupted file") {
+        {
+            RecordWriter writer(path);
+            for (auto const& x: records) { writer.append(x); }
+        }
+
+        std::string data;
+        {
+            std::ifstream in(path, std::ios::binary);
+            data.assign(std::istreambuf_iterator<char>(in), {});
+        }
+
+        std::ofstream(path, std::ios::binary | std::ios::trunc)
+            << data.substr(0, data.size() - 1);
+        REQUIRE_THROWS_AS(RecordReader(path), RecordFileError);
+
+        data[10] = static_cast<char>(0xff);
+        std::ofstream(path, std::ios::binary | std::ios::trunc) << data;
+        RecordReader reader(path);
+        REQUIRE_THROWS_AS(reader.block(0), RecordFileError);
+
+        // sizes of 4GiB are rejected before allocating
+        for (std::size_t const at: {10, 14}) {
+            auto corrupted = data;
+            corrupted.replace(at, 4, 4, static_cast<char>(0xff));
+            std::ofstream(path, std::ios::binary | std::ios::trunc) << corrupted;
+            REQUIRE_THROWS_WITH(RecordReader(path).block(0),
+                                "Record file: corrupted block");
+        }
+    }
+
+    std::remove(path);
+    REQUIRE_THROWS_AS(RecordReader(path), RecordFileError);
+}
@@ -0,0 +1,185 @@
+/*
+  MIT License
+
+  Copyright (c) 2018 Nicolai Trandafil
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+// tested
+#include <serialize/snapshot.hpp>
+
+// local
+#include <serialize/variant_traits.hpp>
+
+// 3rd
+#include <catch2/catch.hpp>
+
+// boost
+#include <boost/hana.hpp>
+
+// std
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+using namespace serialize;
+
+
+namespace {
+
+
+struct Limits : trait::Var<Limits> {
+    int low{0};
+    int high{0};
+};
+
+
+/// Counts the live instances
+struct Counted {
+    explicit Counted(int x) : x(x) { ++live; }
+    Counted(Counted const& rhs) : x(rhs.x) { ++live; }
+    ~Counted() { --live; }
+
+    int x;
+    static std::atomic<int> live;
+};
+
+
+std::atomic<int> Counted::live{0};
+
+
+void writeFile(std::string const& path, std::string const& data) {
+    std::ofstream(path, std::ios::binary | std::ios::trunc) << data;
+}
+
+
+/// Wait for the watcher to publish past `version`
+template <typename T>
+bool waitFor(SharedSnapshot<T> const& x, std::uint64_t version) {
+    for (int i = 0; i < 500 && x.version() <= version; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return x.version() > version;
+}
+
+
+} // namespace
+
+
+BOOST_HANA_ADAPT_STRUCT(Limits, low, high);
+
+
+TEST_CASE("Check SharedSnapshot", "[snapshot]") {
+    auto const path = "serialize_snapshot_test.json";
+
+    SECTION("publish") {
+        SharedSnapshot<Counted> x(Counted(1));
+        {
+            auto const old = x.read();
+            x.publish(Counted(2));
+            REQUIRE(old->x == 1);
+            REQUIRE(x.read()->x == 2);
+            REQUIRE(Counted::live == 2);
+        }
+        x.reclaim();
+        REQUIRE(Counted::live == 1);
+        x.publish(Counted(3));
+        REQUIRE(Counted::live == 1);
+        REQUIRE(x.version() == 3);
+    }
+    REQUIRE(Counted::live == 0);
+
+    SECTION("readers") {
+        Limits first;
+        first.high = 1;
+        SharedSnapshot<Limits> x(first);
+        std::atomic<bool> done{false};
+        std::atomic<int> torn{0};
+        std::vector<std::thread> readers;
+        for (int i = 0; i < 4; ++i) {
+            readers.emplace_back([&] {
+                while (!done) {
+                    auto const r = x.read();
+                    if (r->high != r->low + 1) { ++torn; }
+                }
+            });
+        }
+        for (int i = 1; i < 2000; ++i) {
+            Limits l;
+            l.low = i;
+            l.high = i + 1;
+            x.publish(l);
+        }
+        done = true;
+        for (auto& t: readers) { t.join(); }
+        REQUIRE(torn == 0);
+        REQUIRE(x.read()->low == 1999);
+    }
+
+    SECTION("file") {
+        writeFile(path, R"({"low": 1, "high": 2})");
+        std::atomic<int> errors{0};
+        SnapshotOptions options;
+        options.on_error = [&](std::exception_ptr) { ++errors; };
+        SharedSnapshot<Limits> x(path, options);
+        REQUIRE(x.read()->high == 2);
+
+        writeFile(path, R"({"low": 3, "high": 4})");
+        REQUIRE(waitFor(x, 1));
+        REQUIRE(x.read()->low == 3);
+
+        writeFile(path, R"({"low": 5)");
+        for (int i = 0; i < 500 && errors == 0; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        REQUIRE(errors > 0);
+        REQUIRE(x.read()->low == 3);
+
+        std::string const tmp = std::string(path) + ".tmp";
+        writeFile(tmp, R"({"low": 7, "high": 8})");
+        auto const version = x.version();
+        REQUIRE(std::rename(tmp.c_str(), path) == 0);
+        REQUIRE(waitFor(x, version));
+        REQUIRE(x.read()->high == 8);
+    }
+
+    SECTION("variant") {
+        writeFile(path, R"({"name": "a"})");
+        SnapshotOptions options;
+        options.watch = false;
+        SharedSnapshot<Variant> x(path, options);
+        REQUIRE(x.read()->map().at("name").str() == "a");
+        REQUIRE(x.read()->frozen());
+
+        writeFile(path, R"({"name": "b"})");
+        x.reload();
+        REQUIRE(x.read()->map().at("name").str() == "b");
+        REQUIRE(x.version() == 2);
+    }
+
+    std::remove(path);
+    REQUIRE_THROWS_AS(SharedSnapshot<Variant>(path), SnapshotError);
+}
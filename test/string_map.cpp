@@ -0,0 +1,209 @@
+/*
+  MIT License
+
+  Copyright (c) 2018 Nicolai Trandafil
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+// tested
+#include <serialize/string_map.hpp>
+
+// local
+#include <serialize/field_names.hpp>
+
+// 3rd
+#include <catch2/catch.hpp>
+
+// boost
+#include <boost/hana.hpp>
+
+// std
+#include <iterator>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+
+using namespace serialize;
+
+
+namespace {
+
+
+struct Point {
+    int x;
+    int longitude_in_degrees;
+};
+
+
+} // namespace
+
+
+BOOST_HANA_ADAPT_STRUCT(Point, x, longitude_in_degrees);
+
+
+TEST_CASE("Check StringMap", "[string_map]") {
+    SECTION("small") {
+        StringMap<int> map{{"a", 1}, {"b", 2}, {"a", 3}};
+        REQUIRE(map.size() == 2);
+        REQUIRE(map.at("a") == 1);
+        REQUIRE(map["b"] == 2);
+        REQUIRE(map["c"] == 0);
+        REQUIRE(map.size() == 3);
+        REQUIRE_THROWS_AS(map.at("d"), std::out_of_range);
+        REQUIRE(map.erase("a") == 1);
+        REQUIRE(map.erase("a") == 0);
+        REQUIRE(map.find("a") == map.end());
+        REQUIRE(map.find(std::string("b"))->second == 2);
+    }
+
+    SECTION("insert and erase against std::map") {
+        StringMap<int> map;
+        std::map<std::string, int> expected;
+        for (int i = 0; i < 1000; ++i) {
+            auto const key = "key" + std::to_string(i * 7919 % 1000);
+            map[key] = i;
+            expected[key] = i;
+            if (i % 3 == 0) {
+                auto const victim = "key" + std::to_string(i * 31 % 1000);
+                REQUIRE(map.erase(victim) == expected.erase(victim));
+            }
+        }
+
+        REQUIRE(map.size() == expected.size());
+        for (auto const& [key, value]: expected) {
+            REQUIRE(map.count(key) == 1);
+            REQUIRE(map.at(key) == value);
+        }
+        for (auto const& [key, value]: map) {
+            REQUIRE(expected.at(key) == value);
+        }
+
+        for (auto it = map.begin(); it != map.end();) {
+            it = it->second % 2 ? map.erase(it) : std::next(it);
+        }
+        for (auto const& [key, value]: expected) {
+            REQUIRE(map.contains(key) == (value % 2 == 0));
+        }
+    }
+
+    SECTION("insertion order") {
+        StringMap<int> map;
+        std::vector<std::string> expected;
+        for (int i = 0; i < 100; ++i) {
+            auto const key = "key" + std::to_string(i * 37 % 100);
+            map[key] = i;
+            expected.push_back(key);
+        }
+        for (int i = 0; i < 100; i += 3) {
+            map.erase(expected[std::size_t(i)]);
+        }
+        auto const it = map.erase(std::next(map.begin()));
+        REQUIRE(it->first == expected[4]);
+        for (int i = 99; i >= 0; i -= 3) {
+            expected.erase(expected.begin() + i);
+        }
+        expected.erase(expected.begin() + 1);
+
+        REQUIRE(map.size() == expected.size());
+        std::size_t i = 0;
+        for (auto const& [key, value]: map) {
+            REQUIRE(key == expected[i++]);
+            REQUIRE(map.at(key) == value);
+        }
+    }
+
+    SECTION("erasure keeps the order") {
+        StringMap<int> map;
+        int const n = 100000;
+        for (int i = 0; i < n; ++i) { map["key" + std::to_string(i)] = i; }
+        // tombstones left by iterator erasure, then compacted by key erasure
+        for (auto it = map.begin(); it != map.end();) {
+            it = it->second % 4 == 0 ? map.erase(it) : std::next(it);
+        }
+        for (int i = 1; i < n; i += 4) { map.erase("key" + std::to_string(i)); }
+        map["last"] = n;
+
+        REQUIRE(map.size() == std::size_t(n / 2 + 1));
+        int expected = 2;
+        for (auto const& [key, value]: map) {
+            if (value == n) { break; }
+            REQUIRE(value == expected);
+            REQUIRE(key == "key" + std::to_string(value));
+            expected += expected % 4 == 2 ? 1 : 3;
+        }
+        REQUIRE(expected == n + 2);
+        REQUIRE(std::prev(map.end())->first == "last");
+        REQUIRE(map.at("key2") == 2);
+        REQUIRE_FALSE(map.contains("key4"));
+
+        while (!map.empty()) { map.erase(map.begin()->first); }
+        REQUIRE(map.begin() == map.end());
+        map["a"] = 1;
+        REQUIRE(map.begin()->first == "a");
+    }
+
+    SECTION("copies without tombstones") {
+        StringMap<std::string> map{{"a", "x"}, {"b", "y"}, {"c", "z"}};
+        map.erase(map.begin());
+        auto copy = map;
+        REQUIRE(copy == map);
+        REQUIRE(copy.allocatedBytes() < map.allocatedBytes());
+        copy = map;
+        REQUIRE(copy.begin()->first == "b");
+    }
+
+    SECTION("read only keys") {
+        StringMap<int> map{{"k", 1}};
+        static_assert(std::is_same_v<decltype(map.begin()->first), std::string const&>);
+        static_assert(std::is_same_v<decltype(map.begin()->second), int&>);
+        for (auto&& [key, value]: map) { value = int(key.size()) + 1; }
+        REQUIRE(map.at("k") == 2);
+    }
+
+    SECTION("equality ignores the order") {
+        StringMap<int> const a{{"x", 1}, {"y", 2}};
+        StringMap<int> const b{{"y", 2}, {"x", 1}};
+        StringMap<int> const c{{"y", 2}, {"x", 3}};
+        REQUIRE(a == b);
+        REQUIRE(a != c);
+    }
+
+    SECTION("moved string keys") {
+        StringMap<int> map;
+        std::string key(100, 'k');
+        auto const data = key.data();
+        map.emplace(std::move(key), 1);
+        REQUIRE(map.begin()->first.data() == data);
+    }
+
+    SECTION("field names") {
+        using Names = FieldNames<Point>;
+        static_assert(Names::size == 2);
+        static_assert(Names::names[1] == "longitude_in_degrees");
+        static_assert(Names::hashes[0] == fnv1a("x"));
+
+        StringMap<int> map{{"x", 1}, {"longitude_in_degrees", 2}};
+        REQUIRE(map.at(Names::key(1)) == 2);
+    }
+}
@@ -0,0 +1,258 @@
+/*
+  MIT License
+
+  Copyright (c) 2018 Nicolai Trandafil
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+*/
+
+
+// tested
+#include <serialize/validate.hpp>
+
+// local
+#include <serialize/variant_traits.hpp>
+
+// 3rd
+#include <catch2/catch.hpp>
+
+// boost
+#include <boost/hana.hpp>
+
+// std
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <variant>
+#include <vector>
+
+
+namespace hana = boost::hana;
+
+
+using namespace serialize;
+
+
+namespace {
+
+
+struct Point : trait::Var<Point> {
+    int x{0};
+    unsigned short int y{0};
+};
+
+
+struct Track : trait::Var<Track> {
+    std::string name;
+    std::optional<int> id;
+    std::vector<Point> points;
+    std::map<std::string, double> tags;
+};
+
+
+struct Config : trait::VarDef<Config> {
+    static auto defaults() {
+        return hana::make_map(hana::make_pair(BOOST_HANA_STRING("level"), 3));
+    }
+
+    std::string description;
+    int level{0};
+    std::optional<int> limit;
+};
+
+
+struct Ping : trait::Var<Ping> {
+    static constexpr std::string_view unionTag() { return "ping"; }
+    unsigned int seq{0};
+};
+
+
+struct Pong : trait::Var<Pong> {
+    static constexpr std::string_view unionTag() { return "pong"; }
+    std::string from;
+};
+
+
+using Message = std::variant<Ping, Pong>;
+
+
+/// Reflected, converted from a bare number
+struct Celsius {
+    static Celsius fromVariant(Variant const& x) { return {x.floating()}; }
+    double degrees{0};
+};
+
+
+using Range = decltype(hana::make_map(
+    hana::make_pair(hana::string_c<'l', 'o', 'w'>, int()),
+    hana::make_pair(hana::string_c<'h', 'i', 'g', 'h'>, int())));
+
+
+using Errors = std::vector<std::pair<std::string, ValidationErrc>>;
+
+
+template <typename T>
+Errors errorsOf(Variant const& x) {
+    Errors ret;
+    for (auto const& e: validate<T>(x)) { ret.emplace_back(e.path(), e.code); }
+    return ret;
+}
+
+
+} // namespace
+
+
+BOOST_HANA_ADAPT_STRUCT(Point, x, y);
+BOOST_HANA_ADAPT_STRUCT(Track, name, id, points, tags);
+BOOST_HANA_ADAPT_STRUCT(Config, description, level, limit);
+BOOST_HANA_ADAPT_STRUCT(Ping, seq);
+BOOST_HANA_ADAPT_STRUCT(Pong, from);
+BOOST_HANA_ADAPT_STRUCT(Celsius, degrees);
+
+
+TEST_CASE("Check validate", "[validate]") {
+    Track track;
+    track.name = "track";
+    track.id = 1;
+    track.points.resize(2);
+    track.tags["speed"] = 1.5;
+
+    auto const var = Track::toVariant(track);
+    REQUIRE(validate<Track>(var).empty());
+
+    SECTION("mismatches with paths") {
+        auto map = var.map();
+        auto points = map.at("points").vec();
+        auto point = points[1].map();
+        point.insert_or_assign("x", Variant("one"));
+        point.insert_or_assign("y", Variant(70000));
+        points[1] = Variant(point);
+        map.insert_or_assign("points", Variant(points));
+        map.insert_or_assign("tags", Variant(Variant::Map{{"speed", Variant(1)}}));
+        map.erase("name");
+        map.insert_or_assign("id", Variant());
+
+        auto const errors = errorsOf<Track>(Variant(map));
+        REQUIRE(errors == Errors{
+            {"name", ValidationErrc::missing},
+            {"points[1].x", ValidationErrc::bad_type},
+            {"points[1].y", ValidationErrc::overflow},
+            {"tags.speed", ValidationErrc::bad_type}
+        });
+        REQUIRE_THROWS(Track::fromVariant(Variant(map)));
+    }
+
+    SECTION("root") {
+        REQUIRE(errorsOf<Track>(Variant()) ==
+                Errors{{"", ValidationErrc::empty}});
+        REQUIRE(errorsOf<std::vector<int>>(Variant(1)) ==
+                Errors{{"", ValidationErrc::bad_type}});
+        REQUIRE(validate<int>(Variant(-1)).empty());
+        REQUIRE(errorsOf<unsigned int>(Variant(-1)) ==
+                Errors{{"", ValidationErrc::overflow}});
+    }
+
+    SECTION("defaults") {
+        REQUIRE(validate<Config>(Variant(Variant::Map{
+            {"description", Variant("config")}})).empty());
+        REQUIRE(validate<Config>(Variant(Variant::Map{
+            {"description", Variant("config")}, {"limit", Variant()}})).empty());
+        REQUIRE(errorsOf<Config>(Variant(Variant::Map{})) ==
+                Errors{{"description", ValidationErrc::missing}});
+        REQUIRE_NOTHROW(Config::fromVariant(Variant(Variant::Map{
+            {"description", Variant("config")}, {"limit", Variant()}})));
+    }
+
+    SECTION("tagged unions") {
+        auto const ping = toVariant(Message(Ping()));
+        REQUIRE(validate<Message>(ping).empty());
+
+        auto map = ping.map();
+        map.insert_or_assign("type", Variant("pang"));
+        REQUIRE(errorsOf<Message>(Variant(map)) ==
+                Errors{{"type", ValidationErrc::unknown_tag}});
+
+        map.insert_or_assign("type", Variant("pong"));
+        REQUIRE(errorsOf<Message>(Variant(map)) ==
+                Errors{{"from", ValidationErrc::missing}});
+
+        map.erase("type");
+        REQUIRE(errorsOf<Message>(Variant(map)) ==
+                Errors{{"type", ValidationErrc::missing}});
+    }
+
+    SECTION("conversions of their own") {
+        REQUIRE(validate<Celsius>(Variant(21.5)).empty());
+        REQUIRE(tryFromVariant<Celsius>(Variant(21.5)).value().degrees == 21.5);
+    }
+
+    SECTION("hana maps and constants") {
+        REQUIRE(validate<Range>(Variant(Variant::Map{
+            {"low", Variant(1)}, {"high", Variant(2)}})).empty());
+        REQUIRE(errorsOf<Range>(Variant(Variant::Map{{"high", Variant("2")}})) ==
+                Errors{{"low", ValidationErrc::missing},
+                       {"high", ValidationErrc::bad_type}});
+
+        REQUIRE(validate<hana::int_<3>>(Variant(3)).empty());
+        REQUIRE(errorsOf<hana::int_<3>>(Variant(4)) ==
+                Errors{{"", ValidationErrc::bad_type}});
+    }
+
+    REQUIRE(std::string(describe(ValidationErrc::overflow)) == "out of range");
+}
+
+
+TEST_CASE("Check tryFromVariant", "[validate]") {
+    Track track;
+    track.name = "track";
+    track.points.resize(2);
+
+    auto const var = Track::toVariant(track);
+    auto const ok = tryFromVariant<Track>(var);
+    REQUIRE(ok.has_value());
+    REQUIRE(ok->name == "track");
+    REQUIRE(ok.value().points.size() == 2);
+
+    auto map = var.map();
+    auto points = map.at("points").vec();
+    points[1] = Variant(Variant::Map{{"x", Variant("one")}, {"y", Variant(1)}});
+    map.insert_or_assign("points", Variant(points));
+    map.erase("name");
+
+    auto bad = tryFromVariant<Track>(Variant(map));
+    REQUIRE(!bad);
+    REQUIRE(bad.error().code == ValidationErrc::missing);
+    REQUIRE(bad.error().path() == "name");
+    REQUIRE_THROWS_AS(bad.value(), ConversionError);
+    REQUIRE_THROWS_WITH(bad.value(), "name: missing");
+
+    map.insert_or_assign("name", Variant("track"));
+    bad = tryFromVariant<Track>(Variant(map));
+    REQUIRE(bad.error().message() == "points[1].x: wrong type");
+
+    REQUIRE(tryFromVariant<Message>(toVariant(Message(Pong()))).value().index() == 1);
+
+    REQUIRE(tryFromJson<std::vector<int>>("[1, 2, 3]").value() ==
+            std::vector<int>{1, 2, 3});
+    REQUIRE(tryFromJson<std::vector<int>>("[1, \"2\"]").error().path() == "[1]");
+    REQUIRE(tryFromJson<std::vector<int>>("[1, ").error().code ==
+            ValidationErrc::parse);
+}
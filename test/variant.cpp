@@ -37,8 +37,15 @@
 #include <boost/hana.hpp>
 
 // std
+#include <functional>
 #include <limits.h>
+#include <algorithm>
+#include <cstddef>
+#include <limits>
 #include <sstream>
+#include <string>
+#include <type_traits>
+#include <unordered_set>
 
 
 namespace hana = boost::hana;
@@ -47,6 +54,35 @@ namespace hana = boost::hana;
 using namespace serialize;
 
 
+namespace {
+
+
+/// Maps and vectors nested `depth` times around an integer
+Variant nested(std::size_t depth, int leaf = 0) {
+    Variant ret(leaf);
+    for (std::size_t i = 0; i < depth; ++i) {
+        if (i % 2 == 0) {
+            Variant::Map map;
+            map.emplace("k", std::move(ret));
+            ret = Variant(std::move(map));
+        } else {
+            Variant::Vec vec;
+            vec.push_back(std::move(ret));
+            ret = Variant(std::move(vec));
+        }
+    }
+    return ret;
+}
+
+
+} // namespace
+
+
+static_assert(std::is_nothrow_move_constructible_v<Variant>);
+static_assert(std::is_nothrow_move_assignable_v<Variant>);
+static_assert(std::is_nothrow_swappable_v<Variant>);
+
+
 TEST_CASE("Check Variant", "[Variant]") {
     SECTION("boolean") {
         bool const expected{true};
@@ -328,6 +364,20 @@ TEST_CASE("Check Variant", "[Variant]") {
             REQUIRE(var == Variant::fromJson(json_str));
             REQUIRE_THROWS_AS(Variant::fromJson("{abc"), std::runtime_error);
         }
+
+        SECTION("source order") {
+            std::string const json = R"({"z":1,"k":{"b":true,"a":null},)"
+                R"("y":[3,{"q":2,"p":1}],"x":"s","j":4,"i":5,"h":6,)"
+                R"("g":7,"f":8,"e":9,"d":10})";
+            auto var = Variant::fromJson(json);
+            REQUIRE(var.toJson() == json);
+            REQUIRE(Variant::fromCbor(var.toCbor()).toJson() == json);
+
+            var.mapMut().erase("y");
+            var.mapMut().emplace("a", Variant(0));
+            REQUIRE(var.toJson() == R"({"z":1,"k":{"b":true,"a":null},)"
+                R"("x":"s","j":4,"i":5,"h":6,"g":7,"f":8,"e":9,"d":10,"a":0})");
+        }
     }
 
     SECTION("ostream") {
@@ -391,5 +441,263 @@ TEST_CASE("Check Variant", "[Variant]") {
 
     SECTION("typeInfo") {
         REQUIRE(Variant(int(1)).typeInfo() == typeid(int(1)));
+        REQUIRE(Variant(1UL).typeInfo() == typeid(1UL));
+        REQUIRE(Variant('a').typeInfo() == typeid(char));
+        REQUIRE(Variant(std::numeric_limits<unsigned long>::max()).typeInfo() ==
+                typeid(unsigned long));
+    }
+
+    SECTION("integers of any type") {
+        REQUIRE(Variant(1) == Variant(1L));
+        REQUIRE(Variant(1) == Variant(1U));
+        REQUIRE(Variant(short(-1)) == Variant(-1L));
+        REQUIRE(Variant(1) != Variant(true));
+        REQUIRE(Variant(1) != Variant(1.0));
+        REQUIRE(Variant(1L) == Variant::fromJson(Variant(1L).toJson()));
+        REQUIRE(Variant(1UL) == Variant::fromCbor(Variant(1UL).toCbor()));
+
+        auto const max = std::numeric_limits<unsigned long>::max();
+        REQUIRE(Variant(max) != Variant(-1L));
+        REQUIRE(Variant(max).ulongInt() == max);
+        REQUIRE(Variant(max).toJson() == std::to_string(max));
+        REQUIRE_THROWS_AS(Variant(max).longInt(), VariantIntegralOverflow);
+        REQUIRE(Variant(-1L).toCbor() == Variant(-1).toCbor());
+        REQUIRE(Variant(300U).shortInt() == 300);
+        REQUIRE_THROWS_AS(Variant(300L).character(), VariantIntegralOverflow);
+        REQUIRE_FALSE(Variant(-1).is<unsigned int>());
+        REQUIRE(Variant(5UL).is<char>());
+    }
+}
+
+
+TEST_CASE("Check Variant hash", "[Variant]") {
+    Variant const a(Variant::Map{
+        {"x", Variant(1)}, {"y", Variant(Variant::Vec{Variant("a"), Variant(2.5)})}
+    });
+    Variant const b(Variant::Map{
+        {"y", Variant(Variant::Vec{Variant("a"), Variant(2.5)})}, {"x", Variant(1)}
+    });
+
+    REQUIRE(a == b);
+    REQUIRE(a.hash() == b.hash());
+    REQUIRE(std::hash<Variant>()(a) == a.hash());
+    REQUIRE(Variant(0.0).hash() == Variant(-0.0).hash());
+    REQUIRE(Variant().hash() == Variant().hash());
+
+    REQUIRE(Variant(1).hash() != Variant(2).hash());
+    REQUIRE(Variant(1).hash() == Variant(1L).hash());
+    REQUIRE(Variant(1).hash() != Variant(true).hash());
+    REQUIRE(Variant(1).hash() != Variant(1.0).hash());
+    REQUIRE(Variant(Variant::Vec{Variant(1), Variant(2)}).hash() !=
+            Variant(Variant::Vec{Variant(2), Variant(1)}).hash());
+
+    SECTION("cache follows modifications") {
+        auto c = a;
+        REQUIRE(c.hash() == a.hash());
+        c.mapMut().at("y").vecMut().push_back(Variant(3));
+        REQUIRE(c != a);
+        REQUIRE(c.hash() != a.hash());
+        c.mapMut().at("y").vecMut().pop_back();
+        REQUIRE(c == a);
+        REQUIRE(c.hash() == a.hash());
+    }
+
+    SECTION("frozen values") {
+        auto c = a;
+        auto& y = c.mapMut().at("y");
+        c.freeze();
+        REQUIRE(c.frozen());
+        REQUIRE(y.frozen());
+        REQUIRE(c.hash() == a.hash());
+        REQUIRE_FALSE(Variant(c).frozen());
+        REQUIRE_THROWS_AS(y.push_back(Variant(3)), VariantFrozen);
+        Variant const three(3);
+        REQUIRE_THROWS_AS(y = three, VariantFrozen);
+        REQUIRE_THROWS_AS(y.vecMut(), VariantFrozen);
+        REQUIRE(Variant(y) == a.map().at("y"));
+        REQUIRE(c == a);
+
+        c.mapMut().at("y").vecMut().push_back(Variant(3));
+        REQUIRE_FALSE(c.frozen());
+        REQUIRE_FALSE(y.frozen());
+        REQUIRE(c.map().at("x").frozen());
+        REQUIRE(c != a);
+        REQUIRE(c.hash() != a.hash());
+        y.vecMut().pop_back();
+        REQUIRE(c == a);
+        REQUIRE(c.hash() == a.hash());
+    }
+
+    SECTION("moved out of frozen values") {
+        auto c = a;
+        auto& y = c.mapMut().at("y");
+        c.freeze();
+        auto z = std::move(y);
+        REQUIRE(z.frozen());
+        REQUIRE(z == a.map().at("y"));
+        REQUIRE(z.hash() == a.map().at("y").hash());
+        z.vecMut().push_back(Variant(3));
+        REQUIRE_FALSE(z.frozen());
+        REQUIRE(z.hash() != a.map().at("y").hash());
+    }
+
+    SECTION("unordered containers") {
+        std::unordered_set<Variant> set{a, b, Variant(1), Variant("a"), Variant(1)};
+        REQUIRE(set.size() == 3);
+        REQUIRE(set.count(Variant(Variant::Map{
+            {"y", Variant(Variant::Vec{Variant("a"), Variant(2.5)})}, {"x", Variant(1)}
+        })) == 1);
+    }
+}
+
+
+TEST_CASE("Check deep Variant", "[Variant]") {
+    std::size_t const depth = 10000;
+    auto const a = nested(depth);
+    auto const b = nested(depth);
+    auto const c = nested(depth, 1);
+
+    SECTION("walk") {
+        std::size_t entered = 0;
+        std::size_t left = 0;
+        std::size_t level = 0;
+        std::size_t deepest = 0;
+        struct Counter {
+            bool enter(Variant const&, std::string const* key, std::size_t) {
+                ++entered;
+                deepest = std::max(deepest, ++level);
+                return !key || *key == "k";
+            }
+
+            void leave(Variant const&, std::string const*, std::size_t) {
+                ++left;
+                --level;
+            }
+
+            std::size_t& entered;
+            std::size_t& left;
+            std::size_t& level;
+            std::size_t& deepest;
+        };
+
+        a.walk(Counter{entered, left, level, deepest});
+        REQUIRE(entered == depth + 1);
+        REQUIRE(left == depth + 1);
+        REQUIRE(deepest == depth + 1);
+    }
+
+    SECTION("compare and hash") {
+        REQUIRE(a == b);
+        REQUIRE(a != c);
+        REQUIRE(a.hash() == b.hash());
+        REQUIRE(a.hash() != c.hash());
+        REQUIRE(a == b);
+        REQUIRE(a != c);
+    }
+
+    SECTION("print") {
+        std::ostringstream os;
+        os << a;
+        auto const out = os.str();
+        REQUIRE(std::count(out.begin(), out.end(), '{') == depth / 2);
+        REQUIRE(std::count(out.begin(), out.end(), ']') == depth / 2);
+    }
+
+    SECTION("serialize") {
+        REQUIRE(Variant::fromJson(a.toJson()) == a);
+        REQUIRE(Variant::fromCbor(a.toCbor()) == a);
+
+        rapidjson::Document json;
+        a.to(json);
+        REQUIRE(Variant::from(json) == a);
+    }
+
+    SECTION("destroy") {
+        auto x = nested(depth * 10);
+        x = Variant();
+        REQUIRE(x.empty());
+    }
+}
+
+
+TEST_CASE("Check Variant stats", "[Variant]") {
+    auto const var = Variant::fromJson(R"({
+        "name": "x",
+        "a_key_of_length_25_______": [1, 2.5, true, null],
+        "nested": {"deeper": {"": "value"}}
+    })");
+
+    auto const stats = var.stats();
+    REQUIRE(stats.nodes() == 10);
+    REQUIRE(stats.nulls == 1);
+    REQUIRE(stats.booleans == 1);
+    REQUIRE(stats.integers == 1);
+    REQUIRE(stats.floatings == 1);
+    REQUIRE(stats.strings == 2);
+    REQUIRE(stats.vecs == 1);
+    REQUIRE(stats.maps == 3);
+    REQUIRE(stats.max_depth == 4);
+    // "", "name", "nested" and "deeper", the long key
+    REQUIRE(stats.key_lengths[0] == 1);
+    REQUIRE(stats.key_lengths[3] == 3);
+    REQUIRE(stats.key_lengths[5] == 1);
+    REQUIRE(stats.bytes == var.memoryUsage());
+
+    SECTION("capacity") {
+        auto x = var;
+        auto const before = x.memoryUsage();
+        x.mapMut().at("name") = Variant(std::string(100, 'n'));
+        REQUIRE(x.memoryUsage() >= before + 100);
+
+        auto const with_string = x.memoryUsage();
+        x.mapMut().at("a_key_of_length_25_______").vecMut().reserve(100);
+        REQUIRE(x.memoryUsage() >= with_string + 96 * sizeof(Variant));
+        REQUIRE(x.stats().allocations == stats.allocations + 1);
+    }
+}
+
+
+TEST_CASE("Check Variant editing", "[Variant]") {
+    auto doc = Variant::fromJson(R"({"name": "x", "list": [1, 2, 3]})");
+    auto const hash = doc.hash();
+
+    doc["name"] = Variant("y");
+    REQUIRE(doc.map().at("name").str() == "y");
+    REQUIRE(doc.hash() != hash);
+
+    doc["list"].push_back(Variant(4));
+    doc["list"].erase(std::size_t(0));
+    REQUIRE(doc.map().at("list") ==
+            Variant(Variant::Vec{Variant(2), Variant(3), Variant(4)}));
+    REQUIRE_THROWS_AS(doc["list"].erase(std::size_t(3)), std::out_of_range);
+
+    REQUIRE(doc.emplace("extra", Variant(true)).second);
+    REQUIRE_FALSE(doc.emplace("extra", Variant(false)).second);
+    REQUIRE(doc.map().at("extra").boolean());
+    REQUIRE(doc.erase("name") == 1);
+    REQUIRE(doc.erase("name") == 0);
+    REQUIRE(Variant(doc) == doc);
+    REQUIRE(doc.toJson() == R"({"list":[2,3,4],"extra":true})");
+    REQUIRE(doc == Variant::fromJson(doc.toJson()));
+    REQUIRE(doc.hash() == Variant::fromJson(doc.toJson()).hash());
+
+    SECTION("empty becomes a container") {
+        Variant map;
+        map["a"]["b"] = Variant(1);
+        REQUIRE(map.toJson() == R"({"a":{"b":1}})");
+
+        Variant vec;
+        REQUIRE_THROWS_AS(vec.reserve(1), VariantEmpty);
+        vec.push_back(Variant(1));
+        REQUIRE(vec.toJson() == "[1]");
+    }
+
+    SECTION("bad type") {
+        Variant x(1);
+        REQUIRE_THROWS_AS(x["a"], VariantBadType);
+        REQUIRE_THROWS_AS(x.push_back(Variant()), VariantBadType);
+        REQUIRE_THROWS_AS(x.reserve(1), VariantBadType);
+        REQUIRE_THROWS_AS(doc.push_back(Variant()), VariantBadType);
+        REQUIRE_THROWS_AS(Variant().erase("a"), VariantEmpty);
     }
 }
@@ -37,6 +37,13 @@
 // boost
 #include <boost/hana.hpp>
 
+// std
+#include <map>
+#include <optional>
+#include <string_view>
+#include <variant>
+#include <vector>
+
 
 namespace hana = boost::hana;
 
@@ -143,6 +150,52 @@ struct Dict
 };
 
 
+struct Wide
+        : trait::Var<Wide>
+        , trait::UpdateFromVar<Wide>
+        , trait::EqualityComparison<Wide> {
+    int field0{0};
+    int field1{0};
+    int field2{0};
+    int field3{0};
+    int field4{0};
+    int field5{0};
+    int field6{0};
+    int field7{0};
+    int field8{0};
+    int field9{0};
+    int field10{0};
+    int field11{0};
+    int field12{0};
+    int field13{0};
+    int field14{0};
+    int field15{0};
+    int field16{0};
+    int field17{0};
+    int field18{0};
+    int field19{0};
+    int field20{0};
+    int field21{0};
+    int field22{0};
+    int field23{0};
+    int field24{0};
+    int field25{0};
+    int field26{0};
+    int field27{0};
+    int field28{0};
+    int field29{0};
+    int field30{0};
+    int field31{0};
+    int field32{0};
+    int field33{0};
+    int field34{0};
+    int field35{0};
+    int field36{0};
+    int field37{0};
+    int field38{0};
+};
+
+
 } // namespace
 
 
@@ -151,6 +204,14 @@ BOOST_HANA_ADAPT_STRUCT(OptPerson, name, age, hobby);
 BOOST_HANA_ADAPT_STRUCT(Person, name, age, hobby);
 BOOST_HANA_ADAPT_STRUCT(PersonEx, name, hobbies);
 BOOST_HANA_ADAPT_STRUCT(Dict, x, map);
+BOOST_HANA_ADAPT_STRUCT(Wide, field0, field1, field2, field3, field4,
+                        field5, field6, field7, field8, field9,
+                        field10, field11, field12, field13, field14,
+                        field15, field16, field17, field18, field19,
+                        field20, field21, field22, field23, field24,
+                        field25, field26, field27, field28, field29,
+                        field30, field31, field32, field33, field34,
+                        field35, field36, field37, field38);
 
 
 TEST_CASE("detail::toVariant", "[variant_trait_helpers]") {
@@ -520,4 +581,167 @@ TEST_CASE("Check trait::Var fails", "[variant_traits]") {
 
     REQUIRE_THROWS_AS(Car::fromVariant(car_var), VariantBadType);
     REQUIRE(hana::equal(int(1), int(1)));
+
+    // members are checked in declaration order, whatever the input order
+    car_var.erase("name");
+    REQUIRE_THROWS_WITH(Car::fromVariant(car_var), "name not found in map");
+    car_var.emplace("name", Variant(4));
+    REQUIRE_THROWS_AS(Car::fromVariant(car_var), VariantBadType);
+}
+
+
+TEST_CASE("Check trait field dispatch", "[variant_traits]") {
+    using Names = FieldNames<Wide>;
+    for (std::size_t i = 0; i < Names::size; ++i) {
+        REQUIRE(Names::find(Names::names[i]) == i);
+    }
+    REQUIRE(Names::find("field") == Names::size);
+    REQUIRE(Names::find("field99") == Names::size);
+    REQUIRE(Names::find("") == Names::size);
+
+    Wide x;
+    x.field0 = 1;
+    x.field17 = 17;
+    x.field38 = 39;
+    auto var = Wide::toVariant(x);
+    REQUIRE(Wide::fromVariant(var) == x);
+
+    Wide y;
+    y.updateVar(Variant(Variant::Map{
+        {"field17", Variant(17)}, {"field38", Variant(39)}, {"field0", Variant(1)}
+    }));
+    REQUIRE(y == x);
+
+    REQUIRE_THROWS_WITH(y.updateVar(Variant(Variant::Map{{"field99", Variant(1)}})),
+                        "'field99' no such member");
+
+    auto map = var.map();
+    map.erase("field21");
+    REQUIRE_THROWS_WITH(Wide::fromVariant(Variant(map)), "field21 not found in map");
+}
+
+
+namespace {
+
+
+struct Circle
+        : trait::Var<Circle>
+        , trait::EqualityComparison<Circle> {
+    static constexpr std::string_view unionTag() { return "circle"; }
+    int radius{0};
+};
+
+
+struct Rect
+        : trait::Var<Rect>
+        , trait::EqualityComparison<Rect> {
+    static constexpr std::string_view unionTag() { return "rect"; }
+    int width{0};
+    int height{0};
+};
+
+
+/// Converted by hand, with a key named as the discriminator
+struct Memo {
+    static constexpr std::string_view unionTag() { return "memo"; }
+    static Variant toVariant(Memo const&) {
+        return Variant(Variant::Map{{"type", Variant("note")}});
+    }
+    static Memo fromVariant(Variant const&) { return {}; }
+};
+
+
+using Shape = std::variant<Circle, Rect>;
+using Figure = std::variant<Rect, Circle>;
+using Annotated = std::variant<Circle, Memo>;
+
+
+} // namespace
+
+
+BOOST_HANA_ADAPT_STRUCT(Circle, radius);
+BOOST_HANA_ADAPT_STRUCT(Rect, width, height);
+
+
+template <>
+struct serialize::UnionDiscriminator<Figure> {
+    static constexpr std::string_view key = "kind";
+};
+
+
+TEST_CASE("Check tagged union", "[variant_traits]") {
+    Rect rect;
+    rect.width = 2;
+    rect.height = 3;
+
+    Variant::Map const rect_var{
+        {"type", Variant("rect")}, {"width", Variant(2)}, {"height", Variant(3)}
+    };
+
+    REQUIRE(toVariant(Shape(rect)) == Variant(rect_var));
+    REQUIRE(std::get<Rect>(fromVariant<Shape>(Variant(rect_var))) == rect);
+
+    Shape circle{Circle{}};
+    std::get<Circle>(circle).radius = 5;
+    auto const circle_var = toVariant(std::move(circle));
+    REQUIRE(circle_var.map().at("type").str() == "circle");
+    REQUIRE(std::get<Circle>(fromVariant<Shape>(circle_var)).radius == 5);
+
+    auto const figure_var = toVariant(Figure(rect));
+    REQUIRE(figure_var.map().at("kind").str() == "rect");
+    REQUIRE(figure_var.map().count("type") == 0);
+    REQUIRE(fromVariant<Figure>(figure_var).index() == 0);
+
+    REQUIRE(toVariant(std::vector<Shape>{rect, Circle{}}).vec().size() == 2);
+
+    auto map = rect_var;
+    map.erase("type");
+    REQUIRE_THROWS_WITH(fromVariant<Shape>(Variant(map)), "type not found in map");
+
+    map["type"] = Variant("square");
+    REQUIRE_THROWS_WITH(fromVariant<Shape>(Variant(map)),
+                        "'square' no such alternative");
+
+    map["type"] = Variant("circle");
+    REQUIRE_THROWS_WITH(fromVariant<Shape>(Variant(map)), "radius not found in map");
+
+    REQUIRE(toVariant(Annotated(Circle{})).map().at("type").str() == "circle");
+    REQUIRE_THROWS_WITH(toVariant(Annotated(Memo{})),
+                        "type of 'memo' clashes with the discriminator");
+}
+
+
+TEST_CASE("Check fromVariantInto", "[variant_traits]") {
+    Hobby const hobby{1, std::string("Hack")};
+    PersonD person{"Alecu", 16, hobby};
+
+    PersonD target{"Efendi", 70, Hobby{2, std::string("Sleep")}};
+    fromVariantInto(target, Variant(person));
+    REQUIRE(target == person);
+
+    auto map = PersonD::toVariant(person).map();
+    map.erase("name");
+    map.erase("age");
+    fromVariantInto(target, Variant(map));
+    REQUIRE(target == PersonD{"Efendi", hobby});
+
+    std::map<std::string, int> m{{"a", 1}, {"b", 2}};
+    fromVariantInto(m, toVariant(std::map<std::string, int>{{"b", 3}, {"c", 4}}));
+    REQUIRE(m == std::map<std::string, int>{{"b", 3}, {"c", 4}});
+
+    std::vector<std::string> v{"x", "y", "z"};
+    fromVariantInto(v, toVariant(std::vector<std::string>{"a"}));
+    REQUIRE(v == std::vector<std::string>{"a"});
+
+    std::optional<int> o{1};
+    fromVariantInto(o, Variant());
+    REQUIRE(!o.has_value());
+
+    Wide w;
+    w.field3 = 3;
+    fromJsonInto(w, Wide::toVariant(Wide()).toJson());
+    REQUIRE(w == Wide());
+
+    REQUIRE_THROWS_WITH(fromVariantInto(w, Variant(Variant::Map{})),
+                        "field0 not found in map");
 }